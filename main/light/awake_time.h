@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+namespace light {
+
+/** How much of the time the light is lit it also keeps the device awake.
+ *
+ * Without a PWM that runs through light sleep that's all of it, so this is
+ * the saving from being able to sleep at a steady level.
+ */
+class AwakeTime {
+public:
+  /// Account for the time since the last update, then note the new state.
+  void update(int64_t now_us, bool lit, bool awake) {
+    if (this->last_us_ != 0 && this->lit_) {
+      const uint64_t elapsed = now_us - this->last_us_;
+      this->lit_us_ += elapsed;
+      if (this->awake_)
+        this->awake_us_ += elapsed;
+    }
+    this->last_us_ = now_us;
+    this->lit_ = lit;
+    this->awake_ = awake;
+  }
+
+  uint64_t lit_us() const { return this->lit_us_; }
+  uint64_t awake_us() const { return this->awake_us_; }
+
+  /// Share of the lit time spent holding the device awake, in 0.1%.
+  uint32_t awake_permille() const {
+    return this->lit_us_ ? uint32_t(this->awake_us_ * 1000 / this->lit_us_)
+                         : 0;
+  }
+
+protected:
+  int64_t last_us_{0};
+  bool lit_{false};
+  bool awake_{false};
+  uint64_t lit_us_{0};
+  uint64_t awake_us_{0};
+};
+
+} // namespace light
@@ -0,0 +1,127 @@
+#include <array>
+
+#include "effects.h"
+
+namespace light {
+
+static constexpr uint8_t BREATHE_STEPS = 16;
+
+// cos(x) for |x| <= pi, by its series
+static constexpr double cx_cos(double x) {
+  double term = 1.0;
+  double sum = 1.0;
+  for (int i = 1; i < 20; i++) {
+    term *= -x * x / ((2 * i - 1) * (2 * i));
+    sum += term;
+  }
+  return sum;
+}
+
+// One breath is a raised cosine, (1 - cos(2 pi i / 16)) / 2, in straight
+// segments. Only the way up is computed and the way down mirrors it, so the
+// breath is exactly symmetric.
+static constexpr std::array<uint16_t, BREATHE_STEPS> make_breathe_wave() {
+  std::array<uint16_t, BREATHE_STEPS> wave{};
+  for (uint8_t i = 0; i <= BREATHE_STEPS / 2; i++) {
+    const double x = 6.283185307179586 * i / BREATHE_STEPS;
+    const double value = (1.0 - cx_cos(x)) / 2.0;
+    wave[i] = uint16_t(value * EFFECT_SCALE_MAX + 0.5);
+    if (i > 0)
+      wave[BREATHE_STEPS - i] = wave[i];
+  }
+  return wave;
+}
+
+static constexpr std::array<uint16_t, BREATHE_STEPS> BREATHE_WAVE =
+    make_breathe_wave();
+static_assert(BREATHE_WAVE[0] == 0 &&
+                  BREATHE_WAVE[BREATHE_STEPS / 2] == EFFECT_SCALE_MAX,
+              "a breath should run from nothing to full");
+static_assert(BREATHE_WAVE[BREATHE_STEPS / 4] == 32768 &&
+                  BREATHE_WAVE[BREATHE_STEPS / 4 * 3] == 32768,
+              "a breath should be half way at a quarter and three quarters");
+static constexpr uint32_t BREATHE_PERIOD_MS = 4800;
+static constexpr uint16_t BREATHE_MIN = effect_scale_pct(10);
+
+void EffectEngine::start(Effect effect, uint32_t seed) {
+  this->effect_ = effect < EFFECT_COUNT ? effect : EFFECT_NONE;
+  this->rng_.seed(seed);
+  this->phase_ = 0;
+}
+
+EffectStep EffectEngine::next() {
+  switch (this->effect_) {
+  case EFFECT_TWINKLE:
+    return this->twinkle_();
+  case EFFECT_BREATHE:
+    return this->breathe_();
+  case EFFECT_CANDLE:
+    return this->candle_();
+  default:
+    return {.scale = uint16_t(EFFECT_SCALE_MAX),
+            .fade_ms = 0,
+            .duration_ms = UINT32_MAX};
+  }
+}
+
+EffectStep EffectEngine::twinkle_() {
+  // rest at a dim glow for a while, then sparkle up to full and straight back,
+  // sometimes twice in a row
+  if (this->phase_ == 0) {
+    this->phase_ = 1;
+    const uint32_t fade = this->rng_.range(250, 700);
+    return {.scale = uint16_t(this->rng_.range(effect_scale_pct(25),
+                                               effect_scale_pct(50))),
+            .fade_ms = fade,
+            .duration_ms = fade + this->rng_.range(300, 2500)};
+  }
+
+  this->phase_ = this->rng_.one_in(4) ? 2 : 0;
+  const uint32_t fade = this->rng_.range(40, 120);
+  return {.scale = uint16_t(this->rng_.range(effect_scale_pct(85),
+                                             EFFECT_SCALE_MAX)),
+          .fade_ms = fade,
+          .duration_ms = fade + this->rng_.range(0, 80)};
+}
+
+EffectStep EffectEngine::breathe_() {
+  const uint16_t wave = BREATHE_WAVE[this->phase_];
+  this->phase_ = (this->phase_ + 1) % BREATHE_STEPS;
+
+  const uint32_t step_ms = BREATHE_PERIOD_MS / BREATHE_STEPS;
+  return {.scale = uint16_t(BREATHE_MIN +
+                            (EFFECT_SCALE_MAX - BREATHE_MIN) * wave /
+                                EFFECT_SCALE_MAX),
+          .fade_ms = step_ms,
+          .duration_ms = step_ms};
+}
+
+EffectStep EffectEngine::candle_() {
+  // mostly a gentle wander near full, with the odd gust that knocks the flame
+  // down and lets it recover over a few steps
+  if (this->phase_ > 0) {
+    this->phase_--;
+    const uint32_t fade = this->rng_.range(60, 140);
+    return {.scale = uint16_t(this->rng_.range(effect_scale_pct(55),
+                                               effect_scale_pct(85))),
+            .fade_ms = fade,
+            .duration_ms = fade + this->rng_.range(0, 40)};
+  }
+
+  if (this->rng_.one_in(12)) {
+    this->phase_ = this->rng_.range(1, 3);
+    const uint32_t fade = this->rng_.range(25, 60);
+    return {.scale = uint16_t(this->rng_.range(effect_scale_pct(30),
+                                               effect_scale_pct(50))),
+            .fade_ms = fade,
+            .duration_ms = fade};
+  }
+
+  const uint32_t fade = this->rng_.range(80, 220);
+  return {.scale = uint16_t(this->rng_.range(effect_scale_pct(75),
+                                             EFFECT_SCALE_MAX)),
+          .fade_ms = fade,
+          .duration_ms = fade + this->rng_.range(0, 150)};
+}
+
+} // namespace light
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+
+namespace light {
+
+/// Effects the light can run by itself, numbered as on the wire.
+enum Effect : uint8_t {
+  EFFECT_NONE = 0,
+  EFFECT_TWINKLE = 1,
+  EFFECT_BREATHE = 2,
+  EFFECT_CANDLE = 3,
+  EFFECT_COUNT,
+};
+
+/// Full scale of an effect's brightness, relative to the requested level.
+static constexpr uint32_t EFFECT_SCALE_MAX = 0xFFFF;
+
+constexpr uint16_t effect_scale_pct(uint32_t pct) {
+  return pct * EFFECT_SCALE_MAX / 100;
+}
+
+/// Apply an effect's relative brightness to a 16-bit level.
+constexpr uint16_t effect_level(uint16_t level, uint16_t scale) {
+  return (uint32_t(level) * scale + EFFECT_SCALE_MAX / 2) / EFFECT_SCALE_MAX;
+}
+
+/// xorshift32, a few instructions per number and plenty random for flicker.
+class Rng {
+public:
+  explicit Rng(uint32_t seed = 0) { this->seed(seed); }
+
+  void seed(uint32_t seed) { this->state_ = seed != 0 ? seed : 0x9E3779B9; }
+
+  uint32_t next() {
+    uint32_t x = this->state_;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return this->state_ = x;
+  }
+
+  /// Uniform in [lo, hi], by multiply and shift rather than a divide.
+  uint32_t range(uint32_t lo, uint32_t hi) {
+    return lo + uint32_t((uint64_t(this->next()) * (hi - lo + 1)) >> 32);
+  }
+
+  /// True with probability 1 in `n`.
+  bool one_in(uint32_t n) { return this->range(0, n - 1) == 0; }
+
+protected:
+  uint32_t state_;
+};
+
+/** One step of an effect: fade to a brightness, then wait for the next. */
+struct EffectStep {
+  /// Brightness relative to the requested level, EFFECT_SCALE_MAX is the
+  /// requested level itself.
+  uint16_t scale;
+  /// How long the fade to `scale` takes.
+  uint32_t fade_ms;
+  /// Time from the start of this step until the next one is due, at least
+  /// fade_ms.
+  uint32_t duration_ms;
+};
+
+/** Generates twinkle, breathe and candle patterns as a series of fades.
+ *
+ * Each step is a straight fade that the LEDC fade engine runs in hardware, so
+ * the LED task only wakes once per step, exactly when the next one is due,
+ * rather than on a fixed frame tick. Brightness is relative to the requested
+ * level, which is the brightest an effect ever gets. Everything is integer
+ * maths.
+ */
+class EffectEngine {
+public:
+  /// Switch effect, starting the new one from its beginning.
+  void start(Effect effect, uint32_t seed);
+
+  Effect effect() const { return this->effect_; }
+  bool is_active() const { return this->effect_ != EFFECT_NONE; }
+
+  /// The next step of the running effect, which must not be EFFECT_NONE.
+  EffectStep next();
+
+protected:
+  EffectStep twinkle_();
+  EffectStep breathe_();
+  EffectStep candle_();
+
+  Effect effect_{EFFECT_NONE};
+  Rng rng_{};
+  /// Position within the effect's cycle.
+  uint8_t phase_{0};
+};
+
+} // namespace light
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "../utils/ledc_fade.h"
+#include "../utils/response_curve.h"
+#include "../utils/slew_limit.h"
+
+namespace light {
+
+/// Full scale of an internal level, 8-bit Zigbee levels are scaled by 257.
+static constexpr uint32_t LEVEL_MAX = 0xFFFF;
+
+constexpr uint16_t level_from_u8(uint8_t level) { return level * 257; }
+constexpr uint8_t level_to_u8(uint16_t level) { return (level + 128) / 257; }
+
+/** A fade between two levels that can be retargeted at any point.
+ *
+ * The path is a cubic Hermite curve in time. A fade started from rest has the
+ * same slope at both ends, which makes it a straight line, and that line is
+ * then shaped by the Easing curve (any of the response curves in
+ * response_curve.h). Retargeting while moving starts a new curve from
+ * wherever the old one currently is, with the old one's slope and no easing,
+ * so a change of direction bends the light round rather than snapping it.
+ *
+ * The easing is a compile-time table lookup, so every easing costs the same.
+ * Everything is integer maths; times are in milliseconds from any monotonic
+ * clock and wrap safely.
+ */
+template <typename Easing = output::LinearCurve> class BasicFade {
+public:
+  /// Jump straight to a level, with no fade running.
+  void set(uint16_t level, uint32_t now_ms) {
+    this->from_ = level;
+    this->to_ = level;
+    this->start_slope_ = 0;
+    this->end_slope_ = 0;
+    this->start_ms_ = now_ms;
+    this->duration_ms_ = 0;
+    this->eased_ = false;
+  }
+
+  /** Fade to a new level, starting from wherever the current fade is.
+   *
+   * @param to Level to end on.
+   * @param duration_ms How long the new fade takes, 0 jumps straight there.
+   * @param now_ms Current time.
+   */
+  void retarget(uint16_t to, uint32_t duration_ms, uint32_t now_ms) {
+    if (duration_ms == 0) {
+      this->set(to, now_ms);
+      return;
+    }
+
+    int32_t from = this->to_;
+    int32_t start_slope = int32_t(to) - from;
+    bool eased = true;
+    if (this->is_running(now_ms)) {
+      // carry on from here, with the current speed if it's towards the new
+      // target
+      from = this->level_at(now_ms);
+      start_slope = carried_slope_(this->rate_at(now_ms), int32_t(to) - from,
+                                   duration_ms);
+      eased = false;
+    }
+
+    this->from_ = from;
+    this->to_ = to;
+    this->start_slope_ = start_slope;
+    this->end_slope_ = int32_t(to) - from;
+    this->start_ms_ = now_ms;
+    this->duration_ms_ = duration_ms;
+    this->eased_ = eased;
+  }
+
+  /// Level at the given time, clamped to the valid range.
+  uint16_t level_at(uint32_t now_ms) const {
+    if (!this->is_running(now_ms))
+      return this->to_;
+    return this->level_at_param_(this->param_(now_ms));
+  }
+
+  /// Rate of change at the given time, in levels per second.
+  int32_t rate_at(uint32_t now_ms) const {
+    if (!this->is_running(now_ms))
+      return 0;
+
+    if (this->is_eased_()) {
+      // the easing is only known as a table, so difference it
+      const uint32_t elapsed = this->elapsed_(now_ms);
+      const uint32_t before = elapsed < RATE_SPAN_MS ? 0 : RATE_SPAN_MS;
+      const int32_t a = this->level_at(now_ms - before);
+      const int32_t b = this->level_at(now_ms + RATE_SPAN_MS);
+      return (b - a) * 1000 / int32_t(before + RATE_SPAN_MS);
+    }
+
+    const int64_t s = this->param_(now_ms);
+    const int64_t s2 = (s * s) >> 16;
+
+    const int64_t d00 = 6 * s2 - 6 * s;
+    const int64_t d10 = 3 * s2 - 4 * s + ONE;
+    const int64_t d01 = -6 * s2 + 6 * s;
+    const int64_t d11 = 3 * s2 - 2 * s;
+
+    // change over the whole fade at this slope, then per second
+    const int64_t slope = (d00 * this->from_ + d10 * this->start_slope_ +
+                           d01 * this->to_ + d11 * this->end_slope_) >>
+                          16;
+    return int32_t(slope * 1000 / this->duration_ms_);
+  }
+
+  /// Whether the fade is still moving at the given time.
+  bool is_running(uint32_t now_ms) const {
+    return this->elapsed_(now_ms) < this->duration_ms_;
+  }
+
+  /// Time left until the fade reaches its target, 0 once it has.
+  uint32_t remaining_ms(uint32_t now_ms) const {
+    const uint32_t elapsed = this->elapsed_(now_ms);
+    return elapsed < this->duration_ms_ ? this->duration_ms_ - elapsed : 0;
+  }
+
+  /** Whether the level only ever moves towards the target.
+   *
+   * A start slope the same way as the target and at most twice as steep as a
+   * straight line is inside the Fritsch-Carlson bound for a cubic Hermite, so
+   * it never overshoots. retarget() keeps every fade inside it.
+   */
+  bool is_monotonic() const {
+    const int32_t delta = this->to_ - this->from_;
+    if (delta == 0)
+      return this->start_slope_ == 0;
+    if (delta > 0)
+      return this->start_slope_ >= 0 && this->start_slope_ <= 2 * delta;
+    return this->start_slope_ <= 0 && this->start_slope_ >= 2 * delta;
+  }
+
+  uint16_t target() const { return this->to_; }
+  uint32_t start_ms() const { return this->start_ms_; }
+  uint32_t duration_ms() const { return this->duration_ms_; }
+
+protected:
+  // Curve parameter s runs from 0 to ONE over the fade.
+  static constexpr int64_t ONE = 1 << 16;
+  static constexpr uint32_t RATE_SPAN_MS = 4;
+  /// A carried speed is worth at most this long at that speed, however long
+  /// the new fade is, so it dies away quickly rather than pushing on.
+  static constexpr uint32_t CARRY_MS = 150;
+
+  /** Start slope for a retarget, in levels over the whole fade.
+   *
+   * Moving away from the new target, the speed is dropped: carrying it would
+   * keep going the wrong way before turning round. Towards it, the speed is
+   * kept for fades up to CARRY_MS and eased off for longer ones, and never
+   * steeper than is_monotonic() allows.
+   */
+  static int32_t carried_slope_(int32_t rate, int32_t delta,
+                                uint32_t duration_ms) {
+    if (delta == 0 || (rate > 0) != (delta > 0))
+      return 0;
+    const int64_t slope =
+        int64_t(rate) * std::min(duration_ms, CARRY_MS) / 1000;
+    if (delta > 0)
+      return int32_t(std::min<int64_t>(slope, 2 * int64_t(delta)));
+    return int32_t(std::max<int64_t>(slope, 2 * int64_t(delta)));
+  }
+
+  uint32_t elapsed_(uint32_t now_ms) const { return now_ms - this->start_ms_; }
+
+  bool is_eased_() const {
+    return this->eased_ && !std::is_same_v<Easing, output::LinearCurve>;
+  }
+
+  int64_t param_(uint32_t now_ms) const {
+    const int64_t s =
+        (int64_t(this->elapsed_(now_ms)) << 16) / this->duration_ms_;
+    if (this->is_eased_())
+      return output::curve_fine<Easing>(uint16_t(s));
+    return s;
+  }
+
+  uint16_t level_at_param_(int64_t s) const {
+    const int64_t s2 = (s * s) >> 16;
+    const int64_t s3 = (s2 * s) >> 16;
+
+    const int64_t h00 = 2 * s3 - 3 * s2 + ONE;
+    const int64_t h10 = s3 - 2 * s2 + s;
+    const int64_t h01 = -2 * s3 + 3 * s2;
+    const int64_t h11 = s3 - s2;
+
+    const int64_t level = (h00 * this->from_ + h10 * this->start_slope_ +
+                           h01 * this->to_ + h11 * this->end_slope_ + ONE / 2) >>
+                          16;
+    if (level < 0)
+      return 0;
+    if (level > int64_t(LEVEL_MAX))
+      return LEVEL_MAX;
+    return level;
+  }
+
+  int32_t from_{0};
+  int32_t to_{0};
+  /// Slope at the start and end, in levels over the whole fade.
+  int32_t start_slope_{0};
+  int32_t end_slope_{0};
+  uint32_t start_ms_{0};
+  uint32_t duration_ms_{0};
+  /// Whether the easing applies, i.e. this fade started from rest.
+  bool eased_{false};
+};
+
+using Fade = BasicFade<>;
+
+/** Sample the rest of a fade as a duty path for the LEDC fade engine.
+ *
+ * @param output Anything with duty_for(level), e.g. output::CurvedOutput, which
+ * maps a level to a raw duty.
+ * @param points Output, `count` points evenly spaced over the remaining time,
+ * with times relative to now_ms.
+ * @return Number of points written, 0 if the fade has already finished.
+ */
+template <typename FadeT, typename Output>
+size_t fade_to_duty_points(const FadeT &fade, uint32_t now_ms,
+                           const Output &output, ledc::FadePoint *points,
+                           size_t count) {
+  const uint32_t remaining = fade.remaining_ms(now_ms);
+  if (remaining == 0)
+    return 0;
+
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t t = uint32_t(uint64_t(remaining) * (i + 1) / count);
+    points[i] = {.time_ms = t,
+                 .duty = output.duty_for(fade.level_at(now_ms + t))};
+  }
+  return count;
+}
+
+/** Time until the output duty for a fade next changes.
+ *
+ * Stepping a fade on a fixed frame rate writes the same duty over and over
+ * where the fade is slow, and skips codes where it's fast. This finds the
+ * exact millisecond the duty first differs from now by bisecting on time,
+ * so the fade is written only when it changes.
+ *
+ * @param duty Maps a level to the duty as it would be written.
+ * @param max_ms Furthest to look ahead for a fade that isn't monotonic,
+ * which can move away and come back to the same duty in between.
+ * @return Milliseconds from now_ms, the remaining time if the duty doesn't
+ * change before the fade ends, 0 if it already has.
+ */
+template <typename FadeT, typename DutyFn>
+uint32_t next_duty_change_ms(const FadeT &fade, uint32_t now_ms,
+                             uint32_t max_ms, DutyFn &&duty) {
+  const uint32_t remaining = fade.remaining_ms(now_ms);
+  if (remaining == 0)
+    return 0;
+
+  const uint32_t current = duty(fade.level_at(now_ms));
+  uint32_t hi = fade.is_monotonic() || remaining < max_ms ? remaining : max_ms;
+  if (duty(fade.level_at(now_ms + hi)) == current)
+    return hi;
+
+  // the duty is the same at lo and has changed by hi
+  uint32_t lo = 0;
+  while (hi - lo > 1) {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    if (duty(fade.level_at(now_ms + mid)) == current)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return hi;
+}
+
+/** Stretch a retarget until its duty never changes faster than the limit.
+ *
+ * The limit is applied to the fade rather than to each write, so the fade
+ * engine still runs it in hardware and the light still lands when the fade
+ * says it does. A fade already slower than the limit is left alone, so only
+ * jumps and very quick fades are ever slowed down. Stretching a retarget
+ * never speeds up its start, the carried speed is capped independently of
+ * the duration.
+ *
+ * @param duty Maps a level to the duty as it would be written.
+ * @param full_scale Duty meaning fully on, for the limit.
+ * @return Duration to retarget with, at least duration_ms.
+ */
+template <typename FadeT, typename DutyFn>
+uint32_t slew_limited_ms(const FadeT &fade, uint16_t to, uint32_t duration_ms,
+                         uint32_t now_ms, const output::SlewLimit &limit,
+                         uint32_t full_scale, DutyFn &&duty) {
+  // samples the trial fade is checked at, and how many times it's stretched
+  static constexpr uint32_t SAMPLES = 16;
+  static constexpr uint32_t ATTEMPTS = 4;
+
+  const uint32_t from = duty(fade.level_at(now_ms));
+  if (duration_ms == 0) {
+    const uint32_t target = duty(to);
+    duration_ms = limit.min_ms(target > from ? target - from : from - target,
+                               full_scale);
+    if (duration_ms == 0)
+      return 0;
+  }
+
+  for (uint32_t attempt = 0; attempt < ATTEMPTS; attempt++) {
+    FadeT trial = fade;
+    trial.retarget(to, duration_ms, now_ms);
+
+    // the steepest sample step sets how much longer the whole fade needs
+    uint32_t needed_ms = 0;
+    uint32_t last = from;
+    for (uint32_t i = 1; i <= SAMPLES; i++) {
+      const uint32_t next =
+          duty(trial.level_at(now_ms + uint32_t(uint64_t(duration_ms) * i /
+                                                SAMPLES)));
+      const uint32_t step = next > last ? next - last : last - next;
+      needed_ms = std::max(needed_ms, limit.min_ms(step, full_scale) * SAMPLES);
+      last = next;
+    }
+    if (needed_ms <= duration_ms)
+      return duration_ms;
+    duration_ms = needed_ms;
+  }
+  return duration_ms;
+}
+
+} // namespace light
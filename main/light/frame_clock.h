@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+
+namespace light {
+
+struct FrameStats {
+  /// Frames run, i.e. duty writes.
+  uint32_t frames{0};
+  /// Times the task woke while frames were pending, for whatever reason.
+  uint32_t wakeups{0};
+  /// Frames written later than their deadline by more than the overrun
+  /// threshold.
+  uint32_t overruns{0};
+  /// Worst and total lateness of a frame against its deadline.
+  uint32_t max_late_us{0};
+  uint64_t total_late_us{0};
+
+  uint32_t mean_late_us() const {
+    return this->frames ? uint32_t(this->total_late_us / this->frames) : 0;
+  }
+};
+
+/** Frame deadlines for stepping a fade in software.
+ *
+ * Frames aren't on a fixed period: each one is scheduled for the moment the
+ * output next actually changes (see next_duty_change_ms()), so the task only
+ * wakes when there's something to write. Deadlines are absolute, and what to
+ * show is worked out from the time rather than the frame count, so waking
+ * late never stretches the fade.
+ */
+class FrameClock {
+public:
+  /// Start a new run of frames, the first one due at first_us.
+  void start(int64_t first_us) {
+    this->deadline_us_ = first_us;
+    this->stats_ = {};
+  }
+
+  /// How late a frame can be before it counts as an overrun.
+  void set_overrun_us(uint32_t overrun_us) { this->overrun_us_ = overrun_us; }
+
+  /// Schedule the next frame.
+  void schedule(int64_t deadline_us) { this->deadline_us_ = deadline_us; }
+
+  /// How long until the next frame is due, 0 if it already is.
+  uint32_t wait_us(int64_t now_us) const {
+    return now_us < this->deadline_us_ ? uint32_t(this->deadline_us_ - now_us)
+                                       : 0;
+  }
+
+  bool is_due(int64_t now_us) const { return now_us >= this->deadline_us_; }
+
+  /// Record waking up, whether or not a frame was due.
+  void wakeup() { this->stats_.wakeups++; }
+
+  /// Record a frame run at now_us.
+  void frame(int64_t now_us) {
+    const uint32_t late = uint32_t(now_us - this->deadline_us_);
+    this->stats_.frames++;
+    this->stats_.total_late_us += late;
+    if (late > this->stats_.max_late_us)
+      this->stats_.max_late_us = late;
+    if (late > this->overrun_us_)
+      this->stats_.overruns++;
+  }
+
+  const FrameStats &stats() const { return this->stats_; }
+
+protected:
+  int64_t deadline_us_{0};
+  uint32_t overrun_us_{16000};
+  FrameStats stats_{};
+};
+
+} // namespace light
@@ -0,0 +1,150 @@
+#include "level_control.h"
+
+namespace light {
+
+// Transition times on the wire are in tenths of a second, 0xFFFF meaning
+// "use the default".
+static uint32_t transition_from_wire(const uint8_t *p) {
+  const uint16_t tenths = p[0] | (p[1] << 8);
+  if (tenths == 0xFFFF)
+    return DEFAULT_TRANSITION;
+  return uint32_t(tenths) * 100;
+}
+
+static uint8_t clamp_level(int level, uint8_t min) {
+  if (level < min)
+    return min;
+  if (level > MAX_LEVEL)
+    return MAX_LEVEL;
+  return level;
+}
+
+void LevelControl::fade_level_(uint8_t level, uint32_t transition_ms,
+                               uint32_t now_ms) {
+  const uint8_t from = this->level_at(now_ms);
+  this->level_.retarget(level_from_u8(level),
+                        transition_ms_for(transition_ms, from, level), now_ms);
+  this->request_.transition_ms = transition_ms;
+  this->moving_ = false;
+}
+
+void LevelControl::set_on(bool on, uint32_t now_ms) {
+  this->request_.on = on;
+  if (on)
+    this->reached_level_ = this->request_.level;
+  this->fade_level_(on ? this->request_.level : 0, DEFAULT_TRANSITION,
+                    now_ms);
+}
+
+void LevelControl::set_level(uint8_t level, uint32_t now_ms) {
+  if (level > 0)
+    this->request_.on = true;
+  this->request_.level = level;
+  this->reached_level_ = level;
+  this->fade_level_(this->request_.on ? level : 0, DEFAULT_TRANSITION, now_ms);
+}
+
+void LevelControl::move_to_level(uint8_t level, uint32_t transition_ms,
+                                 bool with_on_off, uint32_t now_ms) {
+  level = clamp_level(level, 0);
+  this->moving_ = false;
+  this->reached_level_ = level;
+  if (with_on_off && level == 0) {
+    // fade out, but keep the level to come back to
+    this->request_.on = false;
+    this->fade_level_(0, transition_ms, now_ms);
+    return;
+  }
+  if (with_on_off)
+    this->request_.on = true;
+
+  this->request_.level = level;
+  if (this->request_.on)
+    this->fade_level_(level, transition_ms, now_ms);
+}
+
+void LevelControl::move(bool up, uint8_t rate, bool with_on_off,
+                        uint32_t now_ms) {
+  if (rate == 0)
+    return;
+  if (!this->request_.on && !with_on_off)
+    return;
+  if (rate == 0xFF)
+    rate = 1000 / DEFAULT_MS_PER_LEVEL;
+
+  const uint8_t from = this->level_at(now_ms);
+  const uint8_t to = up ? MAX_LEVEL : (with_on_off ? 0 : MIN_LEVEL);
+  const uint32_t distance = from < to ? to - from : from - to;
+  const uint32_t transition_ms = distance * 1000 / rate;
+
+  if (to == 0) {
+    this->request_.on = false;
+    this->fade_level_(0, transition_ms, now_ms);
+  } else {
+    this->request_.on = true;
+    this->request_.level = to;
+    this->fade_level_(to, transition_ms, now_ms);
+  }
+  this->moving_ = true;
+  this->reached_level_ = to;
+}
+
+void LevelControl::step(bool up, uint8_t step_size, uint32_t transition_ms,
+                        bool with_on_off, uint32_t now_ms) {
+  if (!this->request_.on && !with_on_off)
+    return;
+
+  const int from = this->level_at(now_ms);
+  const int to = up ? from + step_size : from - step_size;
+  this->move_to_level(clamp_level(to, with_on_off ? 0 : MIN_LEVEL),
+                      transition_ms, with_on_off, now_ms);
+}
+
+void LevelControl::stop(uint32_t now_ms) {
+  const uint8_t level = this->level_at(now_ms);
+  if (level == 0) {
+    this->request_.on = false;
+  } else {
+    this->request_.on = true;
+    this->request_.level = level;
+  }
+  this->reached_level_ = level;
+  // the LED task is within a frame or two of the model, so let it catch up
+  // at the default speed rather than jumping
+  this->fade_level_(level, DEFAULT_TRANSITION, now_ms);
+}
+
+bool LevelControl::handle_command(uint8_t command, const uint8_t *payload,
+                                  size_t size, uint32_t now_ms) {
+  const bool with_on_off = command >= LEVEL_CMD_MOVE_TO_LEVEL_WITH_ON_OFF;
+  switch (command) {
+  case LEVEL_CMD_MOVE_TO_LEVEL:
+  case LEVEL_CMD_MOVE_TO_LEVEL_WITH_ON_OFF:
+    if (size < 3)
+      return false;
+    this->move_to_level(payload[0], transition_from_wire(payload + 1),
+                        with_on_off, now_ms);
+    return true;
+  case LEVEL_CMD_MOVE:
+  case LEVEL_CMD_MOVE_WITH_ON_OFF:
+    if (size < 2)
+      return false;
+    this->move(payload[0] == 0, payload[1], with_on_off, now_ms);
+    return true;
+  case LEVEL_CMD_STEP:
+  case LEVEL_CMD_STEP_WITH_ON_OFF:
+    if (size < 4)
+      return false;
+    this->step(payload[0] == 0, payload[1], transition_from_wire(payload + 2),
+               with_on_off, now_ms);
+    return true;
+  case LEVEL_CMD_STOP:
+  case LEVEL_CMD_STOP_WITH_ON_OFF:
+    this->stop(now_ms);
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace light
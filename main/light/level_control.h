@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "effects.h"
+#include "fade.h"
+
+namespace light {
+
+/// Level Control cluster commands (ZCL 3.10.2.3).
+enum LevelCommand : uint8_t {
+  LEVEL_CMD_MOVE_TO_LEVEL = 0x00,
+  LEVEL_CMD_MOVE = 0x01,
+  LEVEL_CMD_STEP = 0x02,
+  LEVEL_CMD_STOP = 0x03,
+  LEVEL_CMD_MOVE_TO_LEVEL_WITH_ON_OFF = 0x04,
+  LEVEL_CMD_MOVE_WITH_ON_OFF = 0x05,
+  LEVEL_CMD_STEP_WITH_ON_OFF = 0x06,
+  LEVEL_CMD_STOP_WITH_ON_OFF = 0x07,
+};
+
+/// Transition time meaning "use the default speed".
+static constexpr uint32_t DEFAULT_TRANSITION = UINT32_MAX;
+
+/// Time the default speed takes per 8-bit level.
+static constexpr uint32_t DEFAULT_MS_PER_LEVEL = 16;
+
+static constexpr uint8_t MIN_LEVEL = 1;
+static constexpr uint8_t MAX_LEVEL = 254;
+
+/** What the light has been asked to do.
+ *
+ * Each request is a whole state rather than a change, so a mailbox can drop
+ * all but the latest.
+ */
+struct LightRequest {
+  bool on;
+  /// Level to show when on, and to come back to after being turned off.
+  uint8_t level;
+  /// How long the fade to this state should take, or DEFAULT_TRANSITION.
+  uint32_t transition_ms;
+  /// Effect to run on top of the level while on.
+  Effect effect;
+};
+
+/// Duration of a fade between two 8-bit levels.
+constexpr uint32_t transition_ms_for(uint32_t transition_ms, uint8_t from,
+                                     uint8_t to) {
+  if (transition_ms != DEFAULT_TRANSITION)
+    return transition_ms;
+  return DEFAULT_MS_PER_LEVEL * (from < to ? to - from : from - to);
+}
+
+/** Tracks the commanded state of the light from On/Off and Level Control
+ * input.
+ *
+ * Move and Step are relative to where the light is, so the commanded level
+ * is modelled over time the same way the LED task fades it; Stop then
+ * freezes it wherever it has got to.
+ */
+class LevelControl {
+public:
+  /// The On/Off attribute was written.
+  void set_on(bool on, uint32_t now_ms);
+
+  /// The CurrentLevel attribute was written, fades at the default speed.
+  void set_level(uint8_t level, uint32_t now_ms);
+
+  /// Run an effect on top of the level, EFFECT_NONE for a steady light.
+  void set_effect(Effect effect) { this->request_.effect = effect; }
+
+  /** Handle a Level Control cluster command.
+   *
+   * @param command One of LevelCommand.
+   * @param payload Command payload, after the ZCL header.
+   * @return false if the command is unknown or the payload too short.
+   */
+  bool handle_command(uint8_t command, const uint8_t *payload, size_t size,
+                      uint32_t now_ms);
+
+  void move_to_level(uint8_t level, uint32_t transition_ms, bool with_on_off,
+                     uint32_t now_ms);
+  /// Move at `rate` levels per second until the end of the range or a stop.
+  void move(bool up, uint8_t rate, bool with_on_off, uint32_t now_ms);
+  void step(bool up, uint8_t step_size, uint32_t transition_ms,
+            bool with_on_off, uint32_t now_ms);
+  void stop(uint32_t now_ms);
+
+  /// The state to hand to the LED task.
+  LightRequest request() const { return this->request_; }
+
+  /// Commanded level at the given time, ignoring the on/off state.
+  uint8_t level_at(uint32_t now_ms) const {
+    return level_to_u8(this->level_.level_at(now_ms));
+  }
+
+  /// Whether a Move is still running, so CurrentLevel should keep following
+  /// it.
+  bool is_moving(uint32_t now_ms) const {
+    return this->moving_ && this->level_.is_running(now_ms);
+  }
+
+  /** Level to report as CurrentLevel.
+   *
+   * Where a Move has got to while it runs, otherwise the level the last
+   * command took the light to. That's 0 after a Move down with on/off, even
+   * though the request keeps the level to come back to.
+   */
+  uint8_t current_level(uint32_t now_ms) const {
+    return this->is_moving(now_ms) ? this->level_at(now_ms)
+                                   : this->reached_level_;
+  }
+
+protected:
+  void fade_level_(uint8_t level, uint32_t transition_ms, uint32_t now_ms);
+
+  Fade level_{};
+  /// The last command was a Move, which only gets to its level at the end.
+  bool moving_{false};
+  /// Level the last command fades to, separate from request_.level, which is
+  /// the level to restore when turned back on.
+  uint8_t reached_level_{0};
+  LightRequest request_{.on = false,
+                        .level = 0,
+                        .transition_ms = DEFAULT_TRANSITION,
+                        .effect = EFFECT_NONE};
+};
+
+} // namespace light
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace light {
+
+/** Lock-free single-slot mailbox where the latest value wins.
+ *
+ * Posting never blocks: a value the consumer hasn't taken yet is simply
+ * replaced, so a burst of commands collapses into the last one. Post whole
+ * states rather than deltas for that to be safe.
+ *
+ * Internally this is a triple buffer. The producer and consumer each own one
+ * slot and swap it with the shared middle slot, so neither ever waits on the
+ * other. It's meant for one producer and one consumer; a second producer
+ * arriving while a post is in progress has its value dropped rather than
+ * corrupting the slot.
+ */
+template <typename T> class Mailbox {
+public:
+  /** Post a value, replacing any that hasn't been taken yet.
+   *
+   * @return false if the value was dropped because another post was in
+   * progress.
+   */
+  bool post(const T &value) {
+    if (this->posting_.exchange(1, std::memory_order_acquire)) {
+      this->dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    this->slots_[this->back_] = value;
+    const uint32_t previous = this->middle_.exchange(
+        this->back_ | FRESH, std::memory_order_acq_rel);
+    if (previous & FRESH)
+      this->overwritten_.fetch_add(1, std::memory_order_relaxed);
+    this->back_ = previous & INDEX_MASK;
+
+    this->posting_.store(0, std::memory_order_release);
+    return true;
+  }
+
+  /** Take the latest value, if one has been posted since the last take.
+   *
+   * @return false if there was nothing new, `out` is left alone.
+   */
+  bool take(T &out) {
+    if (!(this->middle_.load(std::memory_order_relaxed) & FRESH))
+      return false;
+
+    const uint32_t previous =
+        this->middle_.exchange(this->front_, std::memory_order_acq_rel);
+    this->front_ = previous & INDEX_MASK;
+    out = this->slots_[this->front_];
+    return true;
+  }
+
+  /// Number of values replaced before the consumer took them.
+  uint32_t overwritten() const {
+    return this->overwritten_.load(std::memory_order_relaxed);
+  }
+
+  /// Number of values dropped because of a concurrent post.
+  uint32_t dropped() const {
+    return this->dropped_.load(std::memory_order_relaxed);
+  }
+
+protected:
+  static constexpr uint32_t INDEX_MASK = 0x3;
+  static constexpr uint32_t FRESH = 0x4;
+
+  T slots_[3]{};
+  /// Slot index owned by the producer.
+  uint32_t back_{0};
+  /// Slot index shared between the two, with FRESH set if not yet taken.
+  std::atomic<uint32_t> middle_{1};
+  /// Slot index owned by the consumer.
+  uint32_t front_{2};
+
+  std::atomic<uint32_t> posting_{0};
+  std::atomic<uint32_t> overwritten_{0};
+  std::atomic<uint32_t> dropped_{0};
+};
+
+} // namespace light
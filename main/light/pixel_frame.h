@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "../utils/response_curve.h"
+#include "effects.h"
+#include "fade.h"
+
+namespace light {
+
+/** A pixel packed as 0x00GGRRBB, the order WS2812s take it on the wire.
+ *
+ * Packed so that blending and scaling work on two channels per multiply:
+ * green and blue sit in the even bytes, red in the odd, and masking with
+ * 0x00FF00FF splits them into lanes with 8 spare bits each for the product.
+ */
+using Pixel = uint32_t;
+
+constexpr Pixel pixel_rgb(uint8_t r, uint8_t g, uint8_t b) {
+  return (Pixel(g) << 16) | (Pixel(r) << 8) | b;
+}
+
+/// Scale a pixel by amount/256, 256 leaving it unchanged.
+constexpr Pixel pixel_scale(Pixel p, uint32_t amount) {
+  const uint32_t even = ((p & 0x00FF00FF) * amount >> 8) & 0x00FF00FF;
+  const uint32_t odd = (((p >> 8) & 0x00FF00FF) * amount) & 0xFF00FF00;
+  return even | odd;
+}
+
+/// Mix from a to b by t/256.
+constexpr Pixel pixel_blend(Pixel a, Pixel b, uint32_t t) {
+  const uint32_t s = 256 - t;
+  const uint32_t even =
+      (((a & 0x00FF00FF) * s + (b & 0x00FF00FF) * t) >> 8) & 0x00FF00FF;
+  const uint32_t odd =
+      (((a >> 8) & 0x00FF00FF) * s + ((b >> 8) & 0x00FF00FF) * t) &
+      0xFF00FF00;
+  return even | odd;
+}
+
+static_assert(pixel_scale(pixel_rgb(255, 128, 2), 128) ==
+                  pixel_rgb(127, 64, 1),
+              "scaling should halve every channel");
+static_assert(pixel_blend(pixel_rgb(0, 255, 0), pixel_rgb(255, 0, 0), 128) ==
+                  pixel_rgb(127, 127, 0),
+              "blending should mix every channel");
+
+/** Put one 8-bit channel through the curve and scale it by a gain.
+ *
+ * The curve comes first and the product is kept at 16 bits, so only the
+ * final value is rounded to 8 bits. Scaling first rounds the channel to 8
+ * bits before the curve, which leaves outputs up to 3 counts out and turns
+ * the dimmest lit pixels off.
+ *
+ * @param gain Curved brightness, 0xFFFF leaving the channel at full scale.
+ */
+template <typename Curve>
+constexpr uint8_t pixel_channel(uint8_t value, uint32_t gain) {
+  const uint32_t linear =
+      (output::CURVE_TABLE<Curve>[value] * gain + 0x8000) >> 16;
+  return uint8_t((linear * 255 + 0x8000) >> 16);
+}
+
+/// The gain for an overall brightness out of 256, on the same curve.
+template <typename Curve> constexpr uint32_t pixel_gain(uint32_t brightness) {
+  if (brightness >= 256)
+    return output::CURVE_TABLE_MAX;
+  return output::curve_fine<Curve>(uint16_t(brightness * 0xFFFF / 256));
+}
+
+static_assert(pixel_channel<output::GammaCurve>(
+                  255, pixel_gain<output::GammaCurve>(256)) == 255,
+              "full brightness should leave a channel at full scale");
+static_assert(pixel_channel<output::GammaCurve>(
+                  0, pixel_gain<output::GammaCurve>(256)) == 0,
+              "black should stay black");
+
+/** Renders a string of pixels with the same fades and curve as the PWM
+ * output.
+ *
+ * Each frame cross-fades every pixel from where it was to a target frame,
+ * driven by one shared Fade, so a new target mid-fade bends round from
+ * wherever each pixel had got to just like a level change does. Each channel
+ * is put through the response curve and then scaled by the curved overall
+ * brightness on the way into the wire buffer.
+ */
+template <typename Curve = output::GammaCurve> class PixelFrame {
+public:
+  /// Buffers for `count` pixels, owned by the caller.
+  PixelFrame(Pixel *from, Pixel *to, size_t count)
+      : from_(from), to_(to), count_(count) {}
+
+  size_t size() const { return this->count_; }
+
+  /** Hold the pixels where they are now and hand back the target frame.
+   *
+   * Write the new frame into it, then call fade_to().
+   */
+  Pixel *retarget(uint32_t now_ms) {
+    const uint32_t t = this->mix_at_(now_ms);
+    if (!this->settled_) {
+      // the old target is partly shown, so that's where the next fade starts
+      for (size_t i = 0; i < this->count_; i++)
+        this->from_[i] = pixel_blend(this->from_[i], this->to_[i], t);
+      this->settled_ = true;
+    }
+    this->mix_.set(0, now_ms);
+    return this->to_;
+  }
+
+  /// Start fading to the target frame.
+  void fade_to(uint32_t duration_ms, uint32_t now_ms) {
+    this->mix_.retarget(LEVEL_MAX, duration_ms, now_ms);
+    this->settled_ = false;
+  }
+
+  bool is_fading(uint32_t now_ms) const {
+    return this->mix_.is_running(now_ms);
+  }
+
+  /** Render the frame for now_ms as GRB bytes.
+   *
+   * @param brightness Overall level out of 256.
+   * @param out 3 bytes per pixel.
+   */
+  void render(uint32_t now_ms, uint32_t brightness, uint8_t *out) {
+    const uint32_t t = this->mix_at_(now_ms);
+    const uint32_t gain = pixel_gain<Curve>(brightness);
+    for (size_t i = 0; i < this->count_; i++) {
+      const Pixel p = t == 256 ? this->to_[i]
+                               : pixel_blend(this->from_[i], this->to_[i], t);
+      *out++ = pixel_channel<Curve>((p >> 16) & 0xFF, gain);
+      *out++ = pixel_channel<Curve>((p >> 8) & 0xFF, gain);
+      *out++ = pixel_channel<Curve>(p & 0xFF, gain);
+    }
+    if (t == 256 && !this->settled_) {
+      // landed, so the target is where the next fade starts
+      for (size_t i = 0; i < this->count_; i++)
+        this->from_[i] = this->to_[i];
+      this->settled_ = true;
+    }
+  }
+
+  /** Twinkle a target frame, each pixel dimmed by a random amount.
+   *
+   * @param depth How far a pixel can dim, out of 256.
+   */
+  static void twinkle(Pixel *frame, size_t count, Pixel colour, uint32_t depth,
+                      Rng &rng) {
+    for (size_t i = 0; i < count; i++)
+      frame[i] = pixel_scale(colour, 256 - rng.range(0, depth));
+  }
+
+  static void fill(Pixel *frame, size_t count, Pixel colour) {
+    for (size_t i = 0; i < count; i++)
+      frame[i] = colour;
+  }
+
+protected:
+  // the cross-fade position, out of 256
+  uint32_t mix_at_(uint32_t now_ms) const {
+    return (uint32_t(this->mix_.level_at(now_ms)) + 128) >> 8;
+  }
+
+  Pixel *from_;
+  Pixel *to_;
+  size_t count_;
+  Fade mix_{};
+  /// Whether from_ is what's showing, with no fade in flight.
+  bool settled_{true};
+};
+
+} // namespace light
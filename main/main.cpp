@@ -1,20 +1,35 @@
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
 #include <cmath>
 #include <cstdint>
+#include <iterator>
 
 #include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
 #include "esp_zigbee_type.h"
 #include "freertos/projdefs.h"
 #include "hal/gpio_types.h"
 #include "hal/ledc_types.h"
+#include "light/awake_time.h"
+#include "light/effects.h"
+#include "light/fade.h"
+#include "light/frame_clock.h"
+#include "light/level_control.h"
+#include "light/mailbox.h"
 #include "nvs_flash.h"
 #include "portmacro.h"
 #include "soc/gpio_num.h"
 #include "utils/adc_sensor.h"
 #include "utils/binary_output.h"
+#include "utils/curved_output.h"
 #include "utils/gpio.h"
 #include "utils/gpio_binary_output.h"
 #include "utils/isr_gpio.h"
 #include "utils/ledc.h"
+#include "utils/pwm_efficiency.h"
+#include "utils/slew_limit.h"
 #include "zcl/esp_zigbee_zcl_analog_output.h"
 #include "zcl/esp_zigbee_zcl_common.h"
 #include "zigbee/zigbee.h"
@@ -24,36 +39,46 @@
 
 static const char *TAG = "LIGHTS";
 
-gpio::GPIOBinaryOutput *statusLed;
+gpio::GPIOBinaryOutput<esp32::ESP32InternalGPIOPin> *statusLed;
 
-QueueHandle_t ledqueue;
+static uint32_t now_ms() { return pdTICKS_TO_MS(xTaskGetTickCount()); }
 
-struct LedState {
-  bool on;
-  uint8_t level;
-};
+light::Mailbox<light::LightRequest> lightRequests;
+TaskHandle_t ledTask;
 
-struct SetLedState {
-  union {
-    bool on;
-    uint8_t level;
-  } u;
-  bool isOnSet;
-};
+// Only touched from the Zigbee task.
+light::LevelControl levelControl;
+
+zigbee::ZigBeeAttribute *level_attr;
+
+// how often CurrentLevel is updated while a Move runs
+static const uint32_t MOVE_REPORT_MS = 250;
+
+// CurrentLevel follows a Move as it goes rather than jumping to where it
+// ends. Runs on the Zigbee task, from a command or a scheduler alarm.
+static void reportLevel(uint8_t param) {
+  const uint32_t now = now_ms();
+  uint8_t level = levelControl.current_level(now);
+  level_attr->set_attr_in_callback(&level);
+  if (levelControl.is_moving(now))
+    esp_zb_scheduler_alarm(reportLevel, param, MOVE_REPORT_MS);
+}
+
+static void postLightRequest() {
+  statusLed->turn_on();
+  lightRequests.post(levelControl.request());
+  if (ledTask != nullptr)
+    xTaskNotifyGive(ledTask);
+  statusLed->turn_off();
+}
 
 class OnOffHandler : public zigbee::ZigBeeOnValueTrigger<bool> {
   using zigbee::ZigBeeOnValueTrigger<bool>::ZigBeeOnValueTrigger;
 
   void trigger(bool x) {
     ESP_LOGI(TAG, "on off triggered: %d", x);
-    auto msg = SetLedState{.u =
-                               {
-                                   .on = x,
-                               },
-                           .isOnSet = true};
-    statusLed->turn_on();
-    xQueueSend(ledqueue, &msg, portMAX_DELAY);
-    statusLed->turn_off();
+    levelControl.set_on(x, now_ms());
+    postLightRequest();
   }
 };
 
@@ -62,64 +87,277 @@ class SetLevelHandler : public zigbee::ZigBeeOnValueTrigger<uint8_t> {
 
   void trigger(uint8_t x) {
     ESP_LOGI(TAG, "set level triggered: %d", x);
-    auto msg = SetLedState{.u =
-                               {
-                                   .level = x,
-                               },
-                           .isOnSet = false};
-    statusLed->turn_on();
-    xQueueSend(ledqueue, &msg, portMAX_DELAY);
-    statusLed->turn_off();
+    levelControl.set_level(x, now_ms());
+    postLightRequest();
+  }
+};
+
+class EffectHandler : public zigbee::ZigBeeOnValueTrigger<uint16_t> {
+  using zigbee::ZigBeeOnValueTrigger<uint16_t>::ZigBeeOnValueTrigger;
+
+  void trigger(uint16_t x) {
+    ESP_LOGI(TAG, "effect triggered: %d", x);
+    levelControl.set_effect(x < light::EFFECT_COUNT ? light::Effect(x)
+                                                    : light::EFFECT_NONE);
+    postLightRequest();
   }
 };
 
 ledc::LEDCOutput *ledOutput;
+// the main LEDs in perceptual levels, swap the curve here to change the
+// response
+output::CurvedOutput<output::GammaCurve> *ledLevels;
+
+// The PWM runs at a fixed frequency
+static const uint32_t PWM_HZ = 10000;
+// unless this lets it follow the level the light settles at, for the
+// driver's efficiency. Leave it off until DEFAULT_EFFICIENCY_MAP holds
+// measurements of this board's driver, its figures are only a placeholder.
+static const bool PWM_PROFILES = false;
+static ledc::ProfilePolicy pwmProfiles{ledc::DEFAULT_EFFICIENCY_MAP};
+
+// last battery reading, for limiting how hard the LEDs pull on it
+static std::atomic<uint8_t> batteryPercent{100};
+
+// The LED task logs 64-bit values through newlib's full printf and builds
+// fade paths on its stack, several arrays of MAX_FADE_POINTS deep
+static const uint32_t LED_TASK_STACK = 4096;
+// and warns when its deepest use gets within this of the end.
+static const uint32_t LED_TASK_STACK_MARGIN = 512;
+
+// When a fade has to be stepped by hand, frames are written as the duty
+// changes, but no closer together than the old fixed frame rate
+static const uint32_t MIN_FRAME_MS = 16;
+// and no further apart than this while the fade might turn round.
+static const uint32_t MAX_FRAME_MS = 32;
+
+static void writeLevel(uint16_t level) {
+  // keep the full 16-bit level, the LEDC timer dithers whatever falls between
+  // two duty codes
+  ledLevels->write_level(level);
+}
 
 void ledUpdateTask(void *arg) {
-  uint8_t level = 0;
-  uint8_t savedLevel = 0;
+  light::Fade fade;
+  light::FrameClock frameClock;
+  light::EffectEngine effects;
+  light::AwakeTime awakeTime;
+  output::SlewLimit slewLimit;
+  // a frame as late as the shortest gap between frames has lost one
+  frameClock.set_overrun_us(MIN_FRAME_MS * 1000);
+  // a fade has been started and its final level not yet written
+  bool fading = false;
+  // the running fade is stepped by this task rather than the LEDC fade engine
+  bool softwareFade = false;
+  // the level asked for, which a running effect stays at or below
+  uint8_t lightLevel = 0;
+  // an effect is running and its next step is due at effectDueMs
+  bool effectRunning = false;
+  uint32_t effectDueMs = 0;
 
   tl::optional<zigbee::ZigbeeWakelock> wakelock = tl::nullopt;
 
-  for (;;) {
-    SetLedState newStateSet;
-    if (xQueueReceive(ledqueue, &newStateSet, portMAX_DELAY) != pdPASS) {
-      continue;
-    }
+  // sleep until the duty actually changes rather than ticking through
+  // frames that would write the same value
+  auto scheduleFrame = [&](uint32_t now, int64_t nowUs) {
+    const uint32_t waitMs = light::next_duty_change_ms(
+        fade, now, MAX_FRAME_MS,
+        [](uint16_t level) { return ledLevels->fine_duty_for(level); });
+    frameClock.schedule(nowUs + int64_t(std::max(waitMs, MIN_FRAME_MS)) * 1000);
+  };
+
+  auto fadeTo = [&](uint16_t level, uint32_t fadeMs, uint32_t now) {
+    // never step the current faster than the battery can take, which only
+    // ever stretches jumps and very quick fades
+    slewLimit.set_battery_percent(batteryPercent.load());
+    fadeMs = light::slew_limited_ms(
+        fade, level, fadeMs, now, slewLimit,
+        ledOutput->max_duty() << ledc::LEDCOutput::DUTY_FRACTION_BITS,
+        [](uint16_t at) { return ledLevels->fine_duty_for(at); });
+    // retarget from wherever the light is now, the fade engine keeps its
+    // current speed so there's no snap
+    fade.retarget(level, fadeMs, now);
+    // stay awake through transitions, the steady level in between can sleep
+    if (!wakelock)
+      wakelock = zigbee::inhibit_sleep();
 
-    auto desiredLevel = level;
+    ledc::FadePoint points[ledc::LEDCOutput::MAX_FADE_POINTS];
+    const size_t count = light::fade_to_duty_points(
+        fade, now, *ledLevels, points, ledc::LEDCOutput::MAX_FADE_POINTS);
+    const int64_t nowUs = esp_timer_get_time();
+    // a retarget carries on counting against the same fade
+    if (!fading)
+      frameClock.start(nowUs);
+    softwareFade = count == 0 || !ledOutput->start_fade(points, count);
+    if (softwareFade) {
+      frameClock.schedule(nowUs);
+      frameClock.frame(nowUs);
+      writeLevel(fade.level_at(now));
+      scheduleFrame(now, nowUs);
+    }
+    fading = true;
+  };
 
-    if (newStateSet.isOnSet) {
-      if (newStateSet.u.on)
-        desiredLevel = savedLevel;
-      else {
-        savedLevel = level;
-        desiredLevel = 0;
+  for (;;) {
+    awakeTime.update(esp_timer_get_time(), lightLevel > 0,
+                     wakelock.has_value());
+
+    // the end of the fade, the frame deadlines and effect steps are all
+    // absolute times, so waking late never pushes anything after them back
+    const uint32_t waitFrom = now_ms();
+    uint32_t waitMs = UINT32_MAX;
+    if (fading) {
+      waitMs = fade.remaining_ms(waitFrom);
+      if (softwareFade) {
+        const uint32_t frameWaitUs = frameClock.wait_us(esp_timer_get_time());
+        waitMs = std::min(waitMs, (frameWaitUs + 999) / 1000);
       }
-    } else {
-      desiredLevel = newStateSet.u.level;
     }
-
-    if (level > 0 || desiredLevel > 0) {
-      wakelock = zigbee::inhibit_sleep();
-      // need to run setup again after sleeping?
-      ledOutput->setup();
+    if (effectRunning) {
+      const int32_t effectWaitMs = int32_t(effectDueMs - waitFrom);
+      waitMs = std::min(waitMs, uint32_t(std::max(effectWaitMs, int32_t(0))));
     }
+    const TickType_t timeout =
+        waitMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(waitMs);
+
+    const bool notified = ulTaskNotifyTake(pdTRUE, timeout) > 0;
+    if (fading)
+      frameClock.wakeup();
+
+    light::LightRequest request;
+    if (notified && lightRequests.take(request)) {
+      const int64_t requestUs = esp_timer_get_time();
+      ESP_LOGD(TAG,
+               "light request on: %d level: %u transition: %" PRIu32
+               " effect: %u (overwritten: %" PRIu32 ", dropped: %" PRIu32 ")",
+               request.on, request.level, request.transition_ms,
+               request.effect, lightRequests.overwritten(),
+               lightRequests.dropped());
+
+      const uint32_t now = now_ms();
+      const uint8_t level = light::level_to_u8(fade.level_at(now));
+      const uint8_t desiredLevel = request.on ? request.level : 0;
+      const light::Effect effect =
+          desiredLevel > 0 ? request.effect : light::EFFECT_NONE;
+
+      if (desiredLevel == lightLevel && effect == effects.effect())
+        continue;
+
+      if (effect != effects.effect()) {
+        ESP_LOGI(TAG, "effect %u", effect);
+        effects.start(effect, esp_random());
+      }
 
-    int direction = (level < desiredLevel) ? 1 : -1;
-    for (size_t i = level, iEnd = desiredLevel + direction; i != iEnd;
-         i += direction) {
-      auto preGamma = (float)i / 255.0;
-      auto gammaCorrected = std::pow(preGamma, 2.8);
-      ledOutput->set_level(gammaCorrected);
+      if (!fading && !effectRunning && !ledOutput->is_held_in_sleep() &&
+          (level > 0 || desiredLevel > 0)) {
+        wakelock = zigbee::inhibit_sleep();
+        // the LEDC may have been powered down in sleep, this only rewrites
+        // its registers if so, and then its timer comes back from parking
+        const int64_t setupStartUs = esp_timer_get_time();
+        ledOutput->setup();
+        ledOutput->unpark();
+        ESP_LOGD(TAG, "LEDC setup took %" PRId64 " us",
+                 esp_timer_get_time() - setupStartUs);
+      }
 
-      vTaskDelay(pdMS_TO_TICKS(16));
+      fadeTo(light::level_from_u8(desiredLevel),
+             light::transition_ms_for(request.transition_ms, level,
+                                      desiredLevel),
+             now);
+      ESP_LOGD(TAG, "light request to output took %" PRId64 " us",
+               esp_timer_get_time() - requestUs);
+      lightLevel = desiredLevel;
+
+      // the effect carries on from the new level once it gets there
+      effectRunning = effects.is_active();
+      effectDueMs = now + fade.remaining_ms(now);
+      continue;
     }
 
-    level = desiredLevel;
+    const uint32_t now = now_ms();
+    if (fading && fade.is_running(now)) {
+      const int64_t nowUs = esp_timer_get_time();
+      if (softwareFade && frameClock.is_due(nowUs)) {
+        frameClock.frame(nowUs);
+        writeLevel(fade.level_at(now));
+        scheduleFrame(now, nowUs);
+      }
+      continue;
+    }
 
-    if (level == 0) {
-      wakelock.reset();
+    if (fading) {
+      if (!softwareFade && !ledOutput->wait_fade(pdMS_TO_TICKS(100))) {
+        ESP_LOGW(TAG, "fade didn't finish in time");
+      }
+      // land exactly on the target, and stop the channel when at 0 or full
+      writeLevel(fade.target());
+      fading = false;
+
+      // effect steps are fades too, but far too many to log normally
+      const light::FrameStats &stats = frameClock.stats();
+      ESP_LOG_LEVEL_LOCAL(effectRunning ? ESP_LOG_DEBUG : ESP_LOG_INFO, TAG,
+                          "%s fade: %" PRIu32 " frames, %" PRIu32
+                          " wakeups, %" PRIu32 " overruns, late by %" PRIu32
+                          " us max, %" PRIu32 " us mean",
+                          softwareFade ? "software" : "hardware", stats.frames,
+                          stats.wakeups, stats.overruns, stats.max_late_us,
+                          stats.mean_late_us());
+      ESP_LOG_LEVEL_LOCAL(effectRunning ? ESP_LOG_DEBUG : ESP_LOG_INFO, TAG,
+                          "awake for %" PRIu64 " of %" PRIu64
+                          " ms lit (%" PRIu32 ".%" PRIu32 "%%)",
+                          awakeTime.awake_us() / 1000,
+                          awakeTime.lit_us() / 1000,
+                          awakeTime.awake_permille() / 10,
+                          awakeTime.awake_permille() % 10);
+
+      // in bytes on the IDF
+      const uint32_t stackFree = uxTaskGetStackHighWaterMark(nullptr);
+      if (stackFree < LED_TASK_STACK_MARGIN)
+        ESP_LOGW(TAG, "LED task stack down to %" PRIu32 " bytes free",
+                 stackFree);
+      else
+        ESP_LOGD(TAG, "LED task stack never below %" PRIu32 " bytes free",
+                 stackFree);
+
+      // a steady level needs no wakelock as long as the PWM keeps running
+      // through light sleep
+      const bool lit = fade.target() > 0;
+      if (!lit) {
+        // and off needs nothing running at all
+        ledOutput->hold_in_sleep(false);
+        ledOutput->park();
+      }
+      if (PWM_PROFILES && lit && !effectRunning) {
+        // effects move about too much for a profile to be worth switching to
+        const uint32_t dutyPermille =
+            uint64_t(ledLevels->fine_duty_for(fade.target())) * 1000 /
+            (ledOutput->max_duty() << ledc::LEDCOutput::DUTY_FRACTION_BITS);
+        const ledc::TimerPlan &current = ledOutput->get_plan();
+        const uint32_t hz = pwmProfiles.select(dutyPermille);
+        if (hz != current.frequency_hz) {
+          auto plan = ledc::plan_frequency(current.clock_hz, hz);
+          if (plan.has_value() && ledOutput->switch_plan(*plan))
+            ESP_LOGI(TAG, "PWM at %" PRIu32 " Hz, %u bits for %" PRIu32
+                          " permille", hz, plan->bit_depth, dutyPermille);
+        }
+      }
+      if (!lit || ledOutput->hold_in_sleep(true))
+        wakelock.reset();
+    }
+
+    if (effectRunning && int32_t(now - effectDueMs) >= 0) {
+      const light::EffectStep step = effects.next();
+      fadeTo(light::effect_level(light::level_from_u8(lightLevel), step.scale),
+             step.fade_ms, now);
+      // the slew limit may have stretched the fade, so the step lasts as
+      // long as the fade actually takes plus the hold after it
+      const uint32_t stepMs =
+          fade.duration_ms() + (step.duration_ms - step.fade_ms);
+      // steps are due on absolute deadlines, unless we've fallen a whole
+      // step behind
+      effectDueMs += stepMs;
+      if (int32_t(now - effectDueMs) >= 0)
+        effectDueMs = now + stepMs;
     }
   }
 }
@@ -171,6 +409,7 @@ void batteryUpdateTask(void *arg) {
     }
 
     uint8_t value = (uint8_t)(r * (200.0 / 100.0));
+    batteryPercent.store((uint8_t)r);
 
     ESP_LOGI(TAG, "Ticking adc, got: %d (raw %f)", value, s);
 
@@ -196,12 +435,10 @@ extern "C" void app_main(void) {
   ledpin->set_drive_strength(GPIO_DRIVE_CAP_2);
   ledpin->set_flags(gpio::FLAG_OUTPUT);
   ledpin->setup();
-  statusLed = new gpio::GPIOBinaryOutput();
+  statusLed = new gpio::GPIOBinaryOutput<esp32::ESP32InternalGPIOPin>();
   statusLed->set_pin(ledpin);
   statusLed->setup();
 
-  ledqueue = xQueueCreate(1, sizeof(LedState));
-
   auto zb = new zigbee::ZigBeeComponent();
   zb->set_basic_cluster("toad-lights", "ben", "2024", 3, 0, 0, 0, "", 0);
   zb->create_default_cluster(1, ESP_ZB_HA_DIMMABLE_LIGHT_DEVICE_ID);
@@ -222,14 +459,28 @@ extern "C" void app_main(void) {
   mainoutputpin->set_flags(gpio::FLAG_OUTPUT);
   mainoutputpin->setup();
   auto mainoutput = new ledc::LEDCOutput(mainoutputpin);
-  mainoutput->set_frequency(10000.0);
+  mainoutput->set_frequency(PWM_PROFILES ? pwmProfiles.frequency_hz()
+                                         : PWM_HZ);
+  // keep the PWM going while the chip light-sleeps at a steady level
+  mainoutput->set_sleep_clock(true);
   mainoutput->set_zero_means_zero(false);
   mainoutput->setup();
   mainoutput->set_state(false);
 
+  if (PWM_PROFILES) {
+    ESP_LOGI(TAG, "PWM profiles estimated to run %" PRIu32 " permille longer "
+                  "than fixed %" PRIu32 " Hz over a typical day",
+             ledc::model_runtime_gain_permille(
+                 ledc::DEFAULT_EFFICIENCY_MAP, ledc::TYPICAL_DAY,
+                 std::size(ledc::TYPICAL_DAY),
+                 *ledc::DEFAULT_EFFICIENCY_MAP.frequency_index(PWM_HZ)),
+             PWM_HZ);
+  }
+
   ledOutput = mainoutput;
+  ledLevels = new output::CurvedOutput<output::GammaCurve>(mainoutput);
 
-  xTaskCreate(ledUpdateTask, "ledUpdate", 2048, NULL, 10, NULL);
+  xTaskCreate(ledUpdateTask, "ledUpdate", LED_TASK_STACK, NULL, 10, &ledTask);
 
 
   (new OnOffHandler(on_off_attr))->setup();
@@ -238,13 +489,51 @@ extern "C" void app_main(void) {
 
   zb->add_cluster(1, ::ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL,
                   ::ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
-  auto level_attr = new zigbee::ZigBeeAttribute(
+  level_attr = new zigbee::ZigBeeAttribute(
       zb, 1, ::ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL,
       ::ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0, ::ESP_ZB_ZCL_ATTR_TYPE_U8);
   level_attr->add_attr(0, 0);
 
   (new SetLevelHandler(level_attr))->setup();
 
+  // Move to Level and friends are handled here rather than by the stack, which
+  // would otherwise step CurrentLevel one write at a time and ignore the
+  // transition time
+  for (uint8_t command = light::LEVEL_CMD_MOVE_TO_LEVEL;
+       command <= light::LEVEL_CMD_STOP_WITH_ON_OFF; command++) {
+    zb->add_command_handler(
+        1, ::ESP_ZB_ZCL_CLUSTER_ID_LEVEL_CONTROL, command,
+        [=](const uint8_t *payload, uint16_t size) {
+          ESP_LOGI(TAG, "level command 0x%02x", command);
+          if (!levelControl.handle_command(command, payload, size, now_ms())) {
+            ESP_LOGW(TAG, "bad level command 0x%02x", command);
+            return;
+          }
+          auto request = levelControl.request();
+          esp_zb_scheduler_alarm_cancel(reportLevel, 0);
+          reportLevel(0);
+          on_off_attr->set_attr_in_callback(&request.on);
+          postLightRequest();
+        });
+  }
+
+  // the effect to run is a Multistate Value, 0 for none
+  zb->add_cluster(1, ::ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE,
+                  ::ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
+  auto effect_states = new zigbee::ZigBeeAttribute(
+      zb, 1, ::ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE,
+      ::ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+      ESP_ZB_ZCL_ATTR_MULTI_VALUE_NUMBER_OF_STATES_ID,
+      ::ESP_ZB_ZCL_ATTR_TYPE_U16);
+  effect_states->add_attr(0, uint16_t(light::EFFECT_COUNT));
+  auto effect_attr = new zigbee::ZigBeeAttribute(
+      zb, 1, ::ESP_ZB_ZCL_CLUSTER_ID_MULTI_VALUE,
+      ::ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+      ESP_ZB_ZCL_ATTR_MULTI_VALUE_PRESENT_VALUE_ID, ::ESP_ZB_ZCL_ATTR_TYPE_U16);
+  effect_attr->add_attr(0, uint16_t(light::EFFECT_NONE));
+
+  (new EffectHandler(effect_attr))->setup();
+
   zb->add_cluster(1, ::ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
                   ::ESP_ZB_ZCL_CLUSTER_SERVER_ROLE);
   power_cfg_battery_remaining = new zigbee::ZigBeeAttribute(
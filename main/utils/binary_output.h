@@ -10,7 +10,7 @@ namespace output {
 class BinaryOutput {
 public:
   /// Set the inversion state of this binary output.
-  void set_inverted(bool inverted) { this->inverted_ = inverted; }
+  virtual void set_inverted(bool inverted) { this->inverted_ = inverted; }
 
   /// Enable or disable this binary output.
   virtual void set_state(bool state) {
@@ -38,4 +38,38 @@ protected:
   bool inverted_{false};
 };
 
+/** BinaryOutput without the virtual calls, for outputs whose type is known.
+ *
+ * Derived provides write_state(bool), which is called directly so the whole
+ * chain down to the pin can inline.
+ */
+template <typename Derived> class StaticBinaryOutput {
+public:
+  /// Set the inversion state of this binary output.
+  void set_inverted(bool inverted) { this->inverted_ = inverted; }
+
+  /// Enable or disable this binary output.
+  void set_state(bool state) {
+    if (state) {
+      this->turn_on();
+    } else {
+      this->turn_off();
+    }
+  }
+
+  /// Enable this binary output.
+  void turn_on() { this->derived_().write_state(!this->inverted_); }
+
+  /// Disable this binary output.
+  void turn_off() { this->derived_().write_state(this->inverted_); }
+
+  /// Return whether this binary output is inverted.
+  bool is_inverted() const { return this->inverted_; }
+
+protected:
+  Derived &derived_() { return *static_cast<Derived *>(this); }
+
+  bool inverted_{false};
+};
+
 } // namespace output
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+#include "response_curve.h"
+
+namespace ledc {
+class LEDCOutput;
+} // namespace ledc
+
+namespace output {
+
+/** Drives an output in 16-bit perceptual levels.
+ *
+ * The response curve is a template parameter, so each output's curve is its
+ * own compile-time table and writing a level is a lookup and a multiply with
+ * no branching on the curve. The output's min/max power and inversion are
+ * applied in fixed point on the way out, so there's no float anywhere.
+ *
+ * Output is ledc::LEDCOutput, or anything with the same duty interface such
+ * as sdm::SDMOutput.
+ */
+template <typename Curve = GammaCurve, typename Output = ledc::LEDCOutput>
+class CurvedOutput {
+public:
+  explicit CurvedOutput(Output *output) : output_(output) {}
+
+  /// Write a level, dithering whatever falls between two duty codes.
+  void write_level(uint16_t level) {
+    this->output_->write_duty_fine(this->fine_duty_for(level));
+  }
+
+  /// Raw duty for a level at the output's current bit depth.
+  uint32_t duty_for(uint16_t level) const {
+    return this->output_->transform_duty(
+        curve_duty_fine<Curve>(level, this->output_->get_bit_depth(), 0),
+        this->output_->max_duty());
+  }
+
+  /// Duty for a level as write_level() writes it, with fractional bits.
+  uint32_t fine_duty_for(uint16_t level) const {
+    constexpr uint8_t fraction_bits = Output::DUTY_FRACTION_BITS;
+    return this->output_->transform_duty(
+        curve_duty_fine<Curve>(level, this->output_->get_bit_depth(),
+                               fraction_bits),
+        this->output_->max_duty() << fraction_bits);
+  }
+
+  Output *output() const { return this->output_; }
+
+protected:
+  Output *output_;
+};
+
+} // namespace output
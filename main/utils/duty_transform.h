@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace output {
+
+/** The stages between a duty and the hardware, composed into one.
+ *
+ * Every stage (min/max power, output inversion, pin inversion) is affine in
+ * the duty, so any chain of them is too: full_scale * offset + duty * scale,
+ * both in Q16. Stages are built and composed with then() when the output is
+ * configured, and each write is a single fused multiply-add and clamp
+ * whatever the chain was. Zero-means-zero is the one exception to affine,
+ * and is carried through as where a zero duty ends up.
+ *
+ * The response curve comes before this as its own table lookup (see
+ * CurvedOutput), and the LEDC dithers the fractional bits after it.
+ */
+struct DutyTransform {
+  static constexpr uint8_t ONE_BITS = 16;
+  static constexpr int32_t ONE = 1 << ONE_BITS;
+
+  int32_t offset{0};
+  int32_t scale{ONE};
+  /// Whether a zero duty goes to zero_offset rather than offset.
+  bool zero_special{false};
+  int32_t zero_offset{0};
+
+  static constexpr DutyTransform identity() { return {}; }
+
+  /// Squeeze the range into [min_power, max_power], both in Q16.
+  static constexpr DutyTransform limits(int32_t min_power, int32_t max_power,
+                                        bool zero_means_zero) {
+    return {min_power, max_power - min_power, zero_means_zero && min_power != 0,
+            0};
+  }
+
+  static constexpr DutyTransform inversion(bool inverted) {
+    return inverted ? DutyTransform{ONE, -ONE, false, 0} : identity();
+  }
+
+  /// This stage followed by `next`.
+  constexpr DutyTransform then(const DutyTransform &next) const {
+    DutyTransform out;
+    out.offset = next.map_(this->offset);
+    out.scale = int32_t((int64_t(next.scale) * this->scale) >> ONE_BITS);
+    const int32_t zero = next.apply_q16_(this->zero_q16_());
+    out.zero_special = zero != out.offset;
+    out.zero_offset = zero;
+    return out;
+  }
+
+  /// Run a duty count out of full_scale through every stage.
+  constexpr uint32_t apply(uint32_t duty, uint32_t full_scale) const {
+    const int64_t out =
+        duty == 0 && this->zero_special
+            ? (int64_t(this->zero_offset) * full_scale + ONE / 2) >> ONE_BITS
+            : (int64_t(this->offset) * full_scale +
+               int64_t(this->scale) * duty + ONE / 2) >>
+                  ONE_BITS;
+    return uint32_t(std::clamp<int64_t>(out, 0, full_scale));
+  }
+
+  /// The same for a 0 to 1 level.
+  constexpr float apply(float level) const {
+    if (level == 0.0f && this->zero_special)
+      return float(this->zero_offset) / ONE;
+    return std::clamp((this->offset + this->scale * level) / ONE, 0.0f, 1.0f);
+  }
+
+protected:
+  // where a Q16 level ends up, ignoring the zero case
+  constexpr int32_t map_(int32_t level) const {
+    return this->offset +
+           int32_t((int64_t(this->scale) * level + ONE / 2) >> ONE_BITS);
+  }
+  constexpr int32_t apply_q16_(int32_t level) const {
+    return level == 0 && this->zero_special ? this->zero_offset
+                                            : this->map_(level);
+  }
+  constexpr int32_t zero_q16_() const {
+    return this->zero_special ? this->zero_offset : this->offset;
+  }
+};
+
+static_assert(DutyTransform::limits(DutyTransform::ONE / 4,
+                                    DutyTransform::ONE / 2, true)
+                      .then(DutyTransform::inversion(true))
+                      .apply(0u, 1000) == 1000,
+              "zero-means-zero should still be inverted");
+static_assert(DutyTransform::inversion(true)
+                      .then(DutyTransform::inversion(true))
+                      .apply(300u, 1000) == 300,
+              "two inversions should cancel");
+
+} // namespace output
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 
 #include "float_output.h"
 
@@ -9,6 +10,7 @@ static const char *const TAG = "output.float";
 void FloatOutput::set_max_power(float max_power) {
   this->max_power_ =
       std::clamp(max_power, this->min_power_, 1.0f); // Clamp to MIN>=MAX>=1.0
+  this->update_duty_transform_();
 }
 
 float FloatOutput::get_max_power() const { return this->max_power_; }
@@ -16,14 +18,36 @@ float FloatOutput::get_max_power() const { return this->max_power_; }
 void FloatOutput::set_min_power(float min_power) {
   this->min_power_ =
       std::clamp(min_power, 0.0f, this->max_power_); // Clamp to 0.0>=MIN>=MAX
+  this->update_duty_transform_();
 }
 
 void FloatOutput::set_zero_means_zero(bool zero_means_zero) {
   this->zero_means_zero_ = zero_means_zero;
+  this->update_duty_transform_();
 }
 
 float FloatOutput::get_min_power() const { return this->min_power_; }
 
+void FloatOutput::set_inverted(bool inverted) {
+  this->inverted_ = inverted;
+  this->update_duty_transform_();
+}
+
+void FloatOutput::set_pin_inverted_(bool pin_inverted) {
+  this->pin_inverted_ = pin_inverted;
+  this->update_duty_transform_();
+}
+
+void FloatOutput::update_duty_transform_() {
+  // zero-means-zero is about the level asked for, so the limits go first
+  this->transform_ =
+      DutyTransform::limits(lroundf(this->min_power_ * DutyTransform::ONE),
+                            lroundf(this->max_power_ * DutyTransform::ONE),
+                            this->zero_means_zero_)
+          .then(DutyTransform::inversion(this->inverted_))
+          .then(DutyTransform::inversion(this->pin_inverted_));
+}
+
 void FloatOutput::set_level(float state) {
   state = std::clamp(state, 0.0f, 1.0f);
 
@@ -35,13 +59,7 @@ void FloatOutput::set_level(float state) {
   }
 #endif
 
-  if (state != 0.0f ||
-      !this->zero_means_zero_) // regardless of min_power_, 0.0 means off
-    state = (state * (this->max_power_ - this->min_power_)) + this->min_power_;
-
-  if (this->is_inverted())
-    state = 1.0f - state;
-  this->write_state(state);
+  this->write_state(this->transform_.apply(state));
 }
 
 void FloatOutput::write_state(bool state) {
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
+
 #include "binary_output.h"
+#include "duty_transform.h"
 
 namespace output {
 
@@ -23,7 +26,8 @@ namespace output {
  *
  * If you want to create a FloatOutput yourself, you essentially just have to
  * override write_state(float). That method will be called for you with
- * inversion and max-min power and offset to min power already applied.
+ * inversion (of the output and the pin, see set_pin_inverted_()) and max-min
+ * power and offset to min power already applied, as one DutyTransform.
  *
  * This interface is compatible with BinaryOutput (and will automatically
  * convert the binary states to floating point states for you). Additionally,
@@ -56,6 +60,9 @@ public:
    */
   void set_zero_means_zero(bool zero_means_zero);
 
+  /// Set the inversion state, keeping the duty transform in step.
+  void set_inverted(bool inverted) override;
+
   /** Set the level of this float output, this is called from the front-end.
    *
    * @param state The new state.
@@ -79,14 +86,41 @@ public:
   /// Get the minimum power output.
   float get_min_power() const;
 
+  /** Apply min/max power and inversion to a duty count, in integer maths.
+   *
+   * The same transform as set_level(), composed whenever the power limits or
+   * inversion change, so callers that already work in duty counts never touch
+   * float. The result is the duty to write to the hardware.
+   *
+   * @param duty Duty count out of full_scale.
+   * @param full_scale Duty count meaning fully on, at any bit depth.
+   */
+  uint32_t transform_duty(uint32_t duty, uint32_t full_scale) const {
+    return this->transform_.apply(duty, full_scale);
+  }
+
+  /// Duty count that leaves the pin at its inactive level, whatever the power
+  /// limits and output inversion would make of a zero.
+  uint32_t pin_off_duty(uint32_t full_scale) const {
+    return this->pin_inverted_ ? full_scale : 0;
+  }
+
 protected:
+  /// For outputs that drive a pin, fold the pin's inversion into the
+  /// transform rather than applying it again on every write.
+  void set_pin_inverted_(bool pin_inverted);
+  void update_duty_transform_();
+
   /// Implement BinarySensor's write_enabled; this should never be called.
   void write_state(bool state) override;
   virtual void write_state(float state) = 0;
 
   float max_power_{1.0f};
   float min_power_{0.0f};
-  bool zero_means_zero_;
+  bool zero_means_zero_{false};
+  bool pin_inverted_{false};
+  /// Every stage from a level to the hardware, composed.
+  DutyTransform transform_{};
 };
 
 } // namespace output
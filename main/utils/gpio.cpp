@@ -117,9 +117,6 @@ void ESP32InternalGPIOPin::pin_mode(gpio::Flags flags) {
 bool ESP32InternalGPIOPin::digital_read() {
   return bool(gpio_get_level(pin_)) != inverted_;
 }
-void ESP32InternalGPIOPin::digital_write(bool value) {
-  gpio_set_level(pin_, value != inverted_ ? 1 : 0);
-}
 void ESP32InternalGPIOPin::detach_interrupt() const { gpio_intr_disable(pin_); }
 
 } // namespace esp32
@@ -6,7 +6,8 @@
 
 namespace esp32 {
 
-class ESP32InternalGPIOPin : public InternalGPIOPin {
+/// Final so that calls through the concrete type skip the vtable and inline.
+class ESP32InternalGPIOPin final : public InternalGPIOPin {
 public:
   void set_pin(gpio_num_t pin) { pin_ = pin; }
   void set_inverted(bool inverted) { inverted_ = inverted; }
@@ -17,7 +18,9 @@ public:
   void setup() override;
   void pin_mode(gpio::Flags flags) override;
   bool digital_read() override;
-  void digital_write(bool value) override;
+  void digital_write(bool value) override {
+    gpio_set_level(pin_, value != inverted_ ? 1 : 0);
+  }
   std::string dump_summary() const override;
   void detach_interrupt() const override;
   ISRInternalGPIOPin to_isr() const override;
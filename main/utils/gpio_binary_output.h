@@ -1,13 +1,29 @@
 #pragma once
 
 #include "binary_output.h"
-#include "gpio.h"
+#include "isr_gpio.h"
 
 namespace gpio {
 
-class GPIOBinaryOutput : public output::BinaryOutput {
+/// Anything GPIOBinaryOutput can drive, including host mocks.
+template <typename Pin>
+concept OutputPin = requires(Pin &pin, bool value) {
+  pin.setup();
+  pin.digital_write(value);
+};
+
+/** Drives a pin on and off.
+ *
+ * With a concrete (final) pin type every call resolves at compile time, so
+ * turning a GPIOBinaryOutput<esp32::ESP32InternalGPIOPin> on is just the
+ * register write. The default goes through GPIOPin's virtual calls and takes
+ * any pin.
+ */
+template <OutputPin Pin = GPIOPin>
+class GPIOBinaryOutput
+    : public output::StaticBinaryOutput<GPIOBinaryOutput<Pin>> {
 public:
-  void set_pin(GPIOPin *pin) { pin_ = pin; }
+  void set_pin(Pin *pin) { pin_ = pin; }
 
   void setup() {
     this->turn_off();
@@ -16,9 +32,11 @@ public:
   }
 
 protected:
-  void write_state(bool state) override { this->pin_->digital_write(state); }
+  friend output::StaticBinaryOutput<GPIOBinaryOutput<Pin>>;
+
+  void write_state(bool state) { this->pin_->digital_write(state); }
 
-  GPIOPin *pin_;
+  Pin *pin_;
 };
 
 } // namespace gpio
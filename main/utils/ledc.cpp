@@ -1,86 +1,74 @@
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 #include <optional>
 
+#include <driver/gpio.h>
 #include <driver/ledc.h>
 #include <esp_log.h>
+#include <esp_sleep.h>
+#include <soc/clk_tree_defs.h>
+#include <soc/ledc_struct.h>
 
 #include "ledc.h"
 
-#define CLOCK_FREQUENCY 80e6f
 #define DEFAULT_CLK LEDC_AUTO_CLK
 
-static const uint8_t SETUP_ATTEMPT_COUNT_MAX = 5;
-
 namespace ledc {
 
 static const char *const TAG = "ledc.output";
 
-static const int MAX_RES_BITS = LEDC_TIMER_BIT_MAX - 1;
 inline ledc_mode_t get_speed_mode(uint8_t) { return LEDC_LOW_SPEED_MODE; }
 
-float ledc_max_frequency_for_bit_depth(uint8_t bit_depth) {
-  return CLOCK_FREQUENCY / float(1 << bit_depth);
-}
-
-float ledc_min_frequency_for_bit_depth(uint8_t bit_depth, bool low_frequency) {
-  const float max_div_num =
-      ((1 << MAX_RES_BITS) - 1) / (low_frequency ? 32.0f : 256.0f);
-  return CLOCK_FREQUENCY / (max_div_num * float(1 << bit_depth));
-}
-
-std::optional<uint8_t> ledc_bit_depth_for_frequency(float frequency) {
-  ESP_LOGV(TAG, "Calculating resolution bit-depth for frequency %f", frequency);
-  for (int i = MAX_RES_BITS; i >= 1; i--) {
-    const float min_frequency =
-        ledc_min_frequency_for_bit_depth(i, (frequency < 100));
-    const float max_frequency = ledc_max_frequency_for_bit_depth(i);
-    if (min_frequency <= frequency && frequency <= max_frequency) {
-      ESP_LOGV(TAG, "Resolution calculated as %d", i);
-      return i;
-    }
-  }
-  return {};
-}
-
+/** Fill in the timer config for a plan, and apply it if asked.
+ *
+ * A timer that's shared with another output is already running the plan, and
+ * reconfiguring it would restart its counter under the other output, so then
+ * the config is only kept for restoring after sleep.
+ */
 esp_err_t configure_timer_frequency(ledc_mode_t speed_mode,
                                     ledc_timer_t timer_num,
-                                    ledc_channel_t chan_num, uint8_t channel,
-                                    uint8_t &bit_depth, float frequency) {
-  bit_depth = *ledc_bit_depth_for_frequency(frequency);
-  if (bit_depth < 1) {
-    ESP_LOGE(TAG, "Frequency %f can't be achieved with any bit depth",
-             frequency);
-  }
-
-  ledc_timer_config_t timer_conf{};
+                                    const TimerPlan &plan,
+                                    ledc_clk_cfg_t clk_cfg, bool apply,
+                                    ledc_timer_config_t &timer_conf) {
+  timer_conf = {};
   timer_conf.speed_mode = speed_mode;
-  timer_conf.duty_resolution = static_cast<ledc_timer_bit_t>(bit_depth);
+  timer_conf.duty_resolution = static_cast<ledc_timer_bit_t>(plan.bit_depth);
   timer_conf.timer_num = timer_num;
-  timer_conf.freq_hz = (uint32_t)frequency;
-  timer_conf.clk_cfg = DEFAULT_CLK;
-
-  // Configure the time with fallback in case of error
-  int attempt_count_max = SETUP_ATTEMPT_COUNT_MAX;
-  esp_err_t init_result = ESP_FAIL;
-  while (attempt_count_max > 0 && init_result != ESP_OK) {
-    init_result = ledc_timer_config(&timer_conf);
-    if (init_result != ESP_OK) {
-      ESP_LOGW(
-          TAG,
-          "Unable to initialize timer with frequency %.1f and bit depth of %u",
-          frequency, bit_depth);
-      // try again with a lower bit depth
-      timer_conf.duty_resolution = static_cast<ledc_timer_bit_t>(--bit_depth);
-    }
-    attempt_count_max--;
-  }
+  timer_conf.freq_hz = plan.frequency_hz;
+  timer_conf.clk_cfg = clk_cfg;
+  if (!apply)
+    return ESP_OK;
 
+  // the plan is already known to fit, so there's nothing to fall back to
+  esp_err_t init_result = ledc_timer_config(&timer_conf);
+  if (init_result != ESP_OK) {
+    ESP_LOGW(TAG,
+             "Unable to initialize timer with frequency %" PRIu32
+             " and bit depth of %u",
+             plan.frequency_hz, plan.bit_depth);
+  }
   return init_result;
 }
 
-constexpr int ledc_angle_to_htop(float angle, uint8_t bit_depth) {
-  return static_cast<int>(angle * ((1U << bit_depth) - 1) / 360.);
+/// Stop a timer nothing is running on, and gate its clock.
+static void stop_timer(const ledc_timer_config_t &timer_conf) {
+  ledc_timer_pause(timer_conf.speed_mode, timer_conf.timer_num);
+  ledc_timer_config_t release = timer_conf;
+  release.deconfigure = true;
+  ledc_timer_config(&release);
+}
+
+static bool fade_func_installed = false;
+
+static bool IRAM_ATTR fade_end_isr(const ledc_cb_param_t *param,
+                                   void *user_arg) {
+  BaseType_t task_woken = pdFALSE;
+  if (param->event == LEDC_FADE_END_EVT) {
+    xSemaphoreGiveFromISR(static_cast<SemaphoreHandle_t>(user_arg),
+                          &task_woken);
+  }
+  return task_woken == pdTRUE;
 }
 
 void LEDCOutput::write_state(float state) {
@@ -89,18 +77,32 @@ void LEDCOutput::write_state(float state) {
     return;
   }
 
-  if (this->pin_->is_inverted())
-    state = 1.0f - state;
-
   this->duty_ = state;
-  const uint32_t max_duty = (uint32_t(1) << this->bit_depth_) - 1;
-  const float duty_rounded = roundf(state * max_duty);
-  auto duty = static_cast<uint32_t>(duty_rounded);
+  const float duty_rounded = roundf(state * this->max_duty());
+  this->write_duty(static_cast<uint32_t>(duty_rounded));
+}
+
+void LEDCOutput::write_duty(uint32_t duty) {
+  if (!initialized_) {
+    ESP_LOGW(TAG, "LEDC output hasn't been initialized yet!");
+    return;
+  }
+  if (this->parked_)
+    this->unpark();
+  if (this->fading_)
+    this->stop_fade();
+
+  const uint32_t max_duty = this->max_duty();
+  if (duty > max_duty)
+    duty = max_duty;
+  this->duty_fine_ = duty << DUTY_FRACTION_BITS;
+
   ESP_LOGV(TAG, "Setting duty: %" PRIu32 " on channel %u", duty,
            this->channel_);
   auto speed_mode = get_speed_mode(channel_);
-  auto chan_num = static_cast<ledc_channel_t>(channel_ % 8);
-  int hpoint = ledc_angle_to_htop(this->phase_angle_, this->bit_depth_);
+  auto chan_num = static_cast<ledc_channel_t>(channel_);
+  // worked out once, phase_hpoint() is floating point
+  const uint32_t hpoint = this->chan_conf_.hpoint;
   if (duty == max_duty) {
     ledc_stop(speed_mode, chan_num, 1);
   } else if (duty == 0) {
@@ -111,98 +113,466 @@ void LEDCOutput::write_state(float state) {
   }
 }
 
+void LEDCOutput::write_duty_fine(uint32_t duty) {
+  const uint32_t fraction_mask = (1U << DUTY_FRACTION_BITS) - 1;
+  if ((duty & fraction_mask) == 0 || !initialized_) {
+    this->write_duty(duty >> DUTY_FRACTION_BITS);
+    return;
+  }
+  if (this->parked_)
+    this->unpark();
+  if (this->fading_)
+    this->stop_fade();
+
+  const uint32_t max_duty = this->max_duty() << DUTY_FRACTION_BITS;
+  if (duty > max_duty)
+    duty = max_duty;
+  this->duty_fine_ = duty;
+
+  auto speed_mode = get_speed_mode(channel_);
+  auto chan_num = static_cast<ledc_channel_t>(channel_);
+  ledc_set_duty_with_hpoint(speed_mode, chan_num, duty >> DUTY_FRACTION_BITS,
+                            this->chan_conf_.hpoint);
+  // the driver only ever writes the integer part, fill in the fraction
+  // before the update latches it
+  LEDC.channel_group[speed_mode].channel[chan_num].duty.duty = duty;
+  ledc_update_duty(speed_mode, chan_num);
+}
+
+bool LEDCOutput::start_fade(const FadePoint *points, size_t count) {
+  if (!initialized_ || !fade_func_installed || count == 0 ||
+      count > MAX_FADE_POINTS) {
+    return false;
+  }
+  if (this->parked_)
+    this->unpark();
+  if (this->fading_)
+    this->stop_fade();
+
+  auto speed_mode = get_speed_mode(channel_);
+  auto chan_num = static_cast<ledc_channel_t>(channel_);
+  const uint32_t max_duty = this->max_duty();
+
+  FadePoint hw_points[MAX_FADE_POINTS];
+  for (size_t i = 0; i < count; i++) {
+    hw_points[i] = {.time_ms = points[i].time_ms,
+                    .duty = std::min(points[i].duty, max_duty)};
+  }
+  // where the fade ends up, unless it's stopped early
+  this->duty_fine_ = hw_points[count - 1].duty << DUTY_FRACTION_BITS;
+
+  // clear out a completion left over from a fade that was stopped
+  xSemaphoreTake(this->fade_done_, 0);
+
+  const uint32_t start_duty = ledc_get_duty(speed_mode, chan_num);
+  esp_err_t err;
+#if SOC_LEDC_GAMMA_CURVE_FADE_SUPPORTED
+  FadeSegment segments[MAX_FADE_POINTS];
+  const size_t n = plan_fade_segments(start_duty, hw_points, count,
+                                      (uint32_t)this->frequency_, segments);
+  if (n == 0)
+    return false;
+
+  ledc_fade_param_config_t params[MAX_FADE_POINTS];
+  for (size_t i = 0; i < n; i++) {
+    params[i].dir = segments[i].increase ? 1 : 0;
+    params[i].cycle_num = segments[i].cycle_num;
+    params[i].scale = segments[i].scale;
+    params[i].step_num = segments[i].step_num;
+  }
+  err = ledc_set_multi_fade_and_start(speed_mode, chan_num, start_duty, params,
+                                      n, LEDC_FADE_NO_WAIT);
+#else
+  err = ledc_set_fade_with_time(speed_mode, chan_num, hw_points[0].duty,
+                                hw_points[0].time_ms);
+  if (err == ESP_OK)
+    err = ledc_fade_start(speed_mode, chan_num, LEDC_FADE_NO_WAIT);
+#endif
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Unable to start fade on channel %u: %s", this->channel_,
+             esp_err_to_name(err));
+    return false;
+  }
+
+  this->fading_ = true;
+  return true;
+}
+
+bool LEDCOutput::wait_fade(TickType_t timeout) {
+  if (!this->fading_)
+    return true;
+  if (xSemaphoreTake(this->fade_done_, timeout) != pdTRUE)
+    return false;
+  this->fading_ = false;
+  return true;
+}
+
+void LEDCOutput::stop_fade() {
+  if (!this->fading_)
+    return;
+  auto speed_mode = get_speed_mode(channel_);
+  auto chan_num = static_cast<ledc_channel_t>(channel_);
+  ledc_fade_stop(speed_mode, chan_num);
+  this->fading_ = false;
+}
+
 void LEDCOutput::setup() {
+  if (this->initialized_) {
+    this->restore_();
+    return;
+  }
+
   ESP_LOGV(TAG, "Entering setup...");
+  if (this->channel_ == NO_CHANNEL) {
+    ESP_LOGE(TAG, "No LEDC channel left for pin %u", this->pin_->get_pin());
+    return;
+  }
   auto speed_mode = get_speed_mode(channel_);
-  auto timer_num = static_cast<ledc_timer_t>((channel_ % 8) / 2);
-  auto chan_num = static_cast<ledc_channel_t>(channel_ % 8);
+  auto chan_num = static_cast<ledc_channel_t>(channel_);
+  // the pin's inversion is fixed by now, fold it into the duty transform
+  this->set_pin_inverted_(this->pin_->is_inverted());
+
+  if (!this->plan_fixed_) {
+    auto plan = plan_frequency(this->clock_hz_(), (uint32_t)this->frequency_);
+    if (!plan.has_value()) {
+      ESP_LOGE(TAG, "Frequency %f can't be achieved with any bit depth",
+               this->frequency_);
+      return;
+    }
+    this->plan_ = *plan;
+  } else if (this->plan_.clock_hz != this->clock_hz_()) {
+    ESP_LOGE(TAG, "Plan is for a %" PRIu32 " Hz clock, not %" PRIu32 " Hz",
+             this->plan_.clock_hz, this->clock_hz_());
+    return;
+  }
+  this->bit_depth_ = this->plan_.bit_depth;
 
-  esp_err_t timer_init_result =
-      configure_timer_frequency(speed_mode, timer_num, chan_num, this->channel_,
-                                this->bit_depth_, this->frequency_);
+  auto grant = allocator.acquire_timer(this->plan_);
+  if (!grant.has_value()) {
+    ESP_LOGE(TAG,
+             "No LEDC timer free for %" PRIu32 " Hz from a %" PRIu32
+             " Hz clock",
+             this->plan_.frequency_hz, this->plan_.clock_hz);
+    return;
+  }
+  this->timer_ = grant->timer;
+  auto timer_num = static_cast<ledc_timer_t>(this->timer_);
+
+  esp_err_t timer_init_result = configure_timer_frequency(
+      speed_mode, timer_num, this->plan_, this->clock_config_(),
+      grant->configure, this->timer_conf_);
 
   if (timer_init_result != ESP_OK) {
     ESP_LOGE(TAG, "Frequency %f can't be achieved with computed bit depth %u",
              this->frequency_, this->bit_depth_);
+    allocator.release_timer(this->timer_);
+    this->timer_ = NO_TIMER;
     return;
   }
-  int hpoint = ledc_angle_to_htop(this->phase_angle_, this->bit_depth_);
+  uint32_t hpoint = phase_hpoint(this->phase_angle_, this->bit_depth_);
 
   ESP_LOGV(TAG, "Configured frequency %f with a bit depth of %u bits",
            this->frequency_, this->bit_depth_);
-  ESP_LOGV(TAG, "Angle of %.1f° results in hpoint %u", this->phase_angle_,
-           hpoint);
+  ESP_LOGV(TAG, "Angle of %.1f° results in hpoint %" PRIu32,
+           this->phase_angle_, hpoint);
 
-  ledc_channel_config_t chan_conf{};
+  ledc_channel_config_t &chan_conf = this->chan_conf_;
+  chan_conf = {};
   chan_conf.gpio_num = pin_->get_pin();
   chan_conf.speed_mode = speed_mode;
   chan_conf.channel = chan_num;
   chan_conf.intr_type = LEDC_INTR_DISABLE;
   chan_conf.timer_sel = timer_num;
-  chan_conf.duty = inverted_ == pin_->is_inverted() ? 0 : (1U << bit_depth_);
+  chan_conf.duty = this->transform_duty(0, 1U << bit_depth_);
   chan_conf.hpoint = hpoint;
   ledc_channel_config(&chan_conf);
+
+  if (this->sleep_clock_) {
+    // keep the pin on the LEDC signal rather than its sleep configuration
+    gpio_sleep_sel_dis(static_cast<gpio_num_t>(pin_->get_pin()));
+  }
+
+  if (!fade_func_installed) {
+    esp_err_t err = ledc_fade_func_install(0);
+    if (err != ESP_OK) {
+      ESP_LOGW(TAG, "Unable to install LEDC fade function: %s",
+               esp_err_to_name(err));
+    } else {
+      fade_func_installed = true;
+    }
+  }
+  if (this->fade_done_ == nullptr)
+    this->fade_done_ = xSemaphoreCreateBinary();
+  ledc_cbs_t callbacks = {.fade_cb = fade_end_isr};
+  ledc_cb_register(speed_mode, chan_num, &callbacks, this->fade_done_);
+  this->fading_ = false;
+
+  this->reset_count_ = allocator.reset_count();
   initialized_ = true;
 }
 
+void LEDCOutput::park() {
+  if (!this->initialized_ || this->parked_)
+    return;
+  if (this->fading_)
+    this->stop_fade();
+
+  auto speed_mode = get_speed_mode(channel_);
+  auto chan_num = static_cast<ledc_channel_t>(channel_);
+  auto pin = static_cast<gpio_num_t>(this->pin_->get_pin());
+  // off is whatever zero comes out as, with any inversion
+  ledc_stop(speed_mode, chan_num, this->transform_duty(0, 1));
+  gpio_hold_en(pin);
+
+  if (allocator.park_timer(this->timer_))
+    stop_timer(this->timer_conf_);
+  this->parked_ = true;
+  ESP_LOGV(TAG, "Parked channel %u", this->channel_);
+}
+
+void LEDCOutput::unpark() {
+  if (!this->parked_)
+    return;
+  // a shared timer may have kept running for the other outputs
+  if (allocator.unpark_timer(this->timer_))
+    ledc_timer_config(&this->timer_conf_);
+  // the channel is rewritten too in case the peripheral lost power while
+  // parked; it comes up at the off level the pin is held at, so the pin never
+  // sees the change
+  ledc_channel_config(&this->chan_conf_);
+  gpio_hold_dis(static_cast<gpio_num_t>(this->pin_->get_pin()));
+  this->parked_ = false;
+  this->reset_count_ = allocator.reset_count();
+  ESP_LOGV(TAG, "Unparked channel %u", this->channel_);
+}
+
+void LEDCOutput::restore_() {
+  // unpark() rewrites everything anyway
+  if (this->parked_)
+    return;
+
+  // the registers read back as reset if the peripheral lost power in sleep
+  uint32_t duty_resolution = 0;
+  ledc_ll_get_duty_resolution(LEDC_LL_GET_HW(), this->timer_conf_.speed_mode,
+                              this->timer_conf_.timer_num, &duty_resolution);
+  const bool timer_reset = duty_resolution != this->bit_depth_;
+  if (timer_reset) {
+    allocator.note_reset();
+  } else if (this->reset_count_ == allocator.reset_count()) {
+    return;
+  }
+
+  // everything was worked out the first time round, so this is just the
+  // register writes
+  ESP_LOGV(TAG, "Restoring channel %u after sleep", this->channel_);
+  if (this->fading_)
+    this->stop_fade();
+  // a shared timer may already have been restored by another output
+  if (timer_reset)
+    ledc_timer_config(&this->timer_conf_);
+  ledc_channel_config(&this->chan_conf_);
+  this->reset_count_ = allocator.reset_count();
+}
+
+bool LEDCOutput::hold_in_sleep(bool hold) {
+  if (!this->sleep_clock_)
+    return false;
+  if (hold == this->held_in_sleep_)
+    return hold;
+
+  // both are reference counted: ON takes a reference and OFF gives it back,
+  // AUTO would leave it held. So only ever change them in pairs.
+  const esp_sleep_pd_option_t option =
+      hold ? ESP_PD_OPTION_ON : ESP_PD_OPTION_OFF;
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RC_FAST, option);
+#if SOC_PM_SUPPORT_TOP_PD
+  // the LEDC itself lives in the top domain
+  esp_sleep_pd_config(ESP_PD_DOMAIN_TOP, option);
+#endif
+  const uint8_t holds = allocator.note_sleep_hold(hold);
+  ESP_LOGD(TAG, "%s channel %u in sleep, %u holds taken",
+           hold ? "Holding" : "Releasing", this->channel_, holds);
+  this->held_in_sleep_ = hold;
+  return hold;
+}
+
+void LEDCOutput::set_channel(uint8_t channel) {
+  if (channel == this->channel_)
+    return;
+  if (this->initialized_) {
+    ESP_LOGW(TAG, "Channel can't change after setup");
+    return;
+  }
+  if (!allocator.claim_channel(channel)) {
+    ESP_LOGE(TAG, "LEDC channel %u is taken or doesn't exist", channel);
+    return;
+  }
+  allocator.release_channel(this->channel_);
+  this->channel_ = channel;
+}
+
+void LEDCOutput::set_phase_angle(float angle) {
+  this->phase_angle_ = angle;
+  // keep the cached config in step for restoring after sleep, before setup()
+  // there's no bit depth yet and setup() works it out from the angle
+  if (this->initialized_)
+    this->chan_conf_.hpoint = phase_hpoint(angle, this->bit_depth_);
+}
+
+void LEDCOutput::set_plan(const TimerPlan &plan) {
+  this->plan_ = plan;
+  this->plan_fixed_ = true;
+  this->frequency_ = plan.frequency_hz;
+}
+
+uint32_t LEDCOutput::clock_hz_() const {
+  return this->sleep_clock_ ? RC_FAST_CLOCK_HZ : APB_CLOCK_HZ;
+}
+
+ledc_clk_cfg_t LEDCOutput::clock_config_() const {
+  return this->sleep_clock_ ? LEDC_USE_RC_FAST_CLK : DEFAULT_CLK;
+}
+
 void LEDCOutput::dump_config() {
   ESP_LOGI(TAG, "LEDC Output:");
   LOG_PIN("  Pin ", this->pin_);
   ESP_LOGI(TAG, "  LEDC Channel: %u", this->channel_);
+  ESP_LOGI(TAG, "  LEDC Timer: %u (shared by %u)", this->timer_,
+           allocator.timer_users(this->timer_));
   ESP_LOGI(TAG, "  PWM Frequency: %.1f Hz", this->frequency_);
   ESP_LOGI(TAG, "  Phase angle: %.1f°", this->phase_angle_);
   ESP_LOGI(TAG, "  Bit depth: %u", this->bit_depth_);
-  ESP_LOGV(TAG, "  Max frequency for bit depth: %f",
-           ledc_max_frequency_for_bit_depth(this->bit_depth_));
-  ESP_LOGV(TAG, "  Min frequency for bit depth: %f",
-           ledc_min_frequency_for_bit_depth(this->bit_depth_,
-                                            (this->frequency_ < 100)));
-  ESP_LOGV(TAG, "  Max frequency for bit depth-1: %f",
-           ledc_max_frequency_for_bit_depth(this->bit_depth_ - 1));
-  ESP_LOGV(TAG, "  Min frequency for bit depth-1: %f",
-           ledc_min_frequency_for_bit_depth(this->bit_depth_ - 1,
-                                            (this->frequency_ < 100)));
-  ESP_LOGV(TAG, "  Max frequency for bit depth+1: %f",
-           ledc_max_frequency_for_bit_depth(this->bit_depth_ + 1));
-  ESP_LOGV(TAG, "  Min frequency for bit depth+1: %f",
-           ledc_min_frequency_for_bit_depth(this->bit_depth_ + 1,
-                                            (this->frequency_ < 100)));
-  ESP_LOGV(TAG, "  Max res bits: %d", MAX_RES_BITS);
-  ESP_LOGV(TAG, "  Clock frequency: %f", CLOCK_FREQUENCY);
+  ESP_LOGI(TAG, "  Parked: %s", this->parked_ ? "yes" : "no");
+  ESP_LOGI(TAG, "  Runs in light sleep: %s",
+           this->sleep_clock_ ? "yes (RC_FAST clock)" : "no");
+  ESP_LOGI(TAG, "  Plan: %" PRIu32 " Hz at %u bits from a %" PRIu32
+           " Hz clock, divider %" PRIu32 ".%02" PRIu32 "%s",
+           this->plan_.frequency_hz, this->plan_.bit_depth,
+           this->plan_.clock_hz, this->plan_.divider >> DIVIDER_FRACTION_BITS,
+           (this->plan_.divider & (DIVIDER_ONE - 1)) * 100 / DIVIDER_ONE,
+           this->plan_.is_flicker_free() ? "" : " (may flicker)");
 }
 
 void LEDCOutput::update_frequency(float frequency) {
-  auto bit_depth_opt = ledc_bit_depth_for_frequency(frequency);
-  if (!bit_depth_opt.has_value()) {
+  auto plan = plan_frequency(this->clock_hz_(), (uint32_t)frequency);
+  if (!plan.has_value()) {
     ESP_LOGE(TAG, "Frequency %f can't be achieved with any bit depth",
-             this->frequency_);
+             frequency);
+    return;
   }
-  this->bit_depth_ = bit_depth_opt.value_or(8);
-  this->frequency_ = frequency;
+  if (this->switch_plan(*plan))
+    this->plan_fixed_ = false;
+}
+
+bool LEDCOutput::switch_plan(const TimerPlan &plan) {
   if (!initialized_) {
-    ESP_LOGW(TAG, "LEDC output hasn't been initialized yet!");
-    return;
+    this->set_plan(plan);
+    return true;
+  }
+  if (plan.clock_hz != this->clock_hz_()) {
+    ESP_LOGE(TAG, "Plan is for a %" PRIu32 " Hz clock, not %" PRIu32 " Hz",
+             plan.clock_hz, this->clock_hz_());
+    return false;
+  }
+
+  // a parked timer may be stopped, and this output's share of it has to be
+  // counted as running before it can move
+  if (this->parked_ && !same_timer_plan(plan, this->plan_))
+    this->unpark();
+
+  // other outputs on this timer keep their frequency, so this one may have to
+  // move to another timer
+  auto grant = allocator.retune_timer(this->timer_, plan);
+  if (!grant.has_value()) {
+    ESP_LOGE(TAG, "No LEDC timer free for %" PRIu32 " Hz, keeping %f Hz",
+             plan.frequency_hz, this->frequency_);
+    return false;
   }
+  if (grant->timer == this->timer_ && !grant->configure)
+    return true;
 
   auto speed_mode = get_speed_mode(channel_);
-  auto timer_num = static_cast<ledc_timer_t>((channel_ % 8) / 2);
-  auto chan_num = static_cast<ledc_channel_t>(channel_ % 8);
+  auto chan_num = static_cast<ledc_channel_t>(channel_);
+  auto timer_num = static_cast<ledc_timer_t>(grant->timer);
+  if (this->fading_) {
+    this->stop_fade();
+    this->duty_fine_ = ledc_get_duty(speed_mode, chan_num)
+                       << DUTY_FRACTION_BITS;
+  }
 
-  esp_err_t timer_init_result =
-      configure_timer_frequency(speed_mode, timer_num, chan_num, this->channel_,
-                                this->bit_depth_, this->frequency_);
+  const uint8_t old_bit_depth = this->bit_depth_;
+  const ledc_timer_config_t old_timer_conf = this->timer_conf_;
+  configure_timer_frequency(speed_mode, timer_num, plan, this->clock_config_(),
+                            false, this->timer_conf_);
+  this->plan_ = plan;
+  this->plan_fixed_ = true;
+  this->bit_depth_ = plan.bit_depth;
+  this->frequency_ = plan.frequency_hz;
+  // the same brightness at the new resolution
+  const uint32_t duty = rescale_duty(this->duty_fine_, old_bit_depth,
+                                     plan.bit_depth, DUTY_FRACTION_BITS);
 
-  if (timer_init_result != ESP_OK) {
-    ESP_LOGE(TAG, "Frequency %f can't be achieved with computed bit depth %u",
-             this->frequency_, this->bit_depth_);
-    return;
+  if (grant->timer == this->timer_) {
+    // ledc_timer_config() would reset the counter mid-period. Staged like
+    // this, the divider and resolution latch at the end of the current
+    // period, the same moment as the rescaled duty written below.
+    ledc_ll_set_clock_divider(LEDC_LL_GET_HW(), speed_mode, timer_num,
+                              plan.divider);
+    ledc_ll_set_duty_resolution(LEDC_LL_GET_HW(), speed_mode, timer_num,
+                                plan.bit_depth);
+    ledc_ll_ls_timer_update(LEDC_LL_GET_HW(), speed_mode, timer_num);
+  } else {
+    // nothing is on a newly claimed timer yet, so it can be set up from
+    // scratch; moving across can cut the current period short
+    if (grant->configure &&
+        ledc_timer_config(&this->timer_conf_) != ESP_OK) {
+      ESP_LOGE(TAG, "Unable to configure timer %u", grant->timer);
+    }
+    ledc_bind_channel_timer(speed_mode, chan_num, timer_num);
+    this->chan_conf_.timer_sel = timer_num;
+    this->timer_ = grant->timer;
+    // left with nothing running on it, or only parked outputs
+    if (grant->stop_previous)
+      stop_timer(old_timer_conf);
+  }
+  // the cached channel comes back up at off after a park or a reset, which
+  // is a different count at the new resolution when the output is inverted
+  this->chan_conf_.duty = this->transform_duty(0, 1U << this->bit_depth_);
+  this->chan_conf_.hpoint = phase_hpoint(this->phase_angle_, this->bit_depth_);
+
+  this->write_duty_fine(duty);
+  return true;
+}
+
+bool StaggeredStrings::add(LEDCOutput *output) {
+  if (this->count_ == CHANNEL_COUNT)
+    return false;
+  if (this->count_ != 0 && output->get_timer() != LEDCOutput::NO_TIMER &&
+      output->get_timer() != this->outputs_[0]->get_timer()) {
+    ESP_LOGW(TAG, "Channel %u is on timer %u, not %u, so won't stay in phase",
+             output->get_channel(), output->get_timer(),
+             this->outputs_[0]->get_timer());
   }
 
-  // re-apply duty
-  this->write_state(this->duty_);
+  this->outputs_[this->count_++] = output;
+  for (size_t i = 0; i < this->count_; i++)
+    this->outputs_[i]->set_phase_angle(stagger_angle(i, this->count_));
+  return true;
+}
+
+CurrentStats StaggeredStrings::model_current(const uint32_t *duties,
+                                             uint32_t string_ma) const {
+  StringLoad loads[CHANNEL_COUNT];
+  const uint8_t bit_depth =
+      this->count_ ? this->outputs_[0]->get_bit_depth() : 0;
+  for (size_t i = 0; i < this->count_; i++) {
+    loads[i] = {.hpoint = stagger_hpoint(i, this->count_, bit_depth),
+                .duty = duties[i],
+                .current_ma = string_ma};
+  }
+  return model_string_current(loads, this->count_, bit_depth);
 }
 
-uint8_t next_ledc_channel =
-    0; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+Allocator allocator; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
 
 } // namespace ledc
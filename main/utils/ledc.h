@@ -1,41 +1,211 @@
 #include "float_output.h"
 #include "gpio.h"
+#include "ledc_alloc.h"
+#include "ledc_fade.h"
+#include "ledc_plan.h"
+#include "pwm_current.h"
 #include <cinttypes>
 
+#include <driver/ledc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <hal/ledc_ll.h>
+#include <soc/soc_caps.h>
+
 #pragma once
 
 namespace ledc {
 
-// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
-extern uint8_t next_ledc_channel;
-
 class LEDCOutput : public output::FloatOutput {
 public:
+  /// Takes the next free channel, if there isn't one setup() fails.
   explicit LEDCOutput(InternalGPIOPin *pin) : pin_(pin) {
-    this->channel_ = next_ledc_channel++;
+    this->channel_ = allocator.allocate_channel().value_or(NO_CHANNEL);
   }
 
-  void set_channel(uint8_t channel) { this->channel_ = channel; }
+  /// Use a specific channel instead, before setup().
+  void set_channel(uint8_t channel);
   void set_frequency(float frequency) { this->frequency_ = frequency; }
-  void set_phase_angle(float angle) { this->phase_angle_ = angle; }
-  /// Dynamically change frequency at runtime
+  /// Delay the start of each pulse by a share of the period, from the next
+  /// duty written.
+  void set_phase_angle(float angle);
+  /** Clock the timer from RC_FAST, which can keep running in light sleep.
+   *
+   * Must be set before setup(). RC_FAST is slower than the 80 MHz APB clock,
+   * so the same frequency gets a couple of bits less resolution.
+   */
+  void set_sleep_clock(bool sleep_clock) { this->sleep_clock_ = sleep_clock; }
+  /** Run a specific timer plan rather than the best one for set_frequency().
+   *
+   * Lets a frequency be traded against resolution on purpose, e.g. with
+   * plan_max_resolution_above(). Must be planned against the clock the output
+   * will use, set before setup().
+   */
+  void set_plan(const TimerPlan &plan);
+  /// Timer plan in use, valid after setup().
+  const TimerPlan &get_plan() const { return this->plan_; }
+  /// Dynamically change frequency at runtime, see switch_plan().
   void update_frequency(float frequency) override;
+  /** Change to another timer plan without a visible glitch.
+   *
+   * The new divider and resolution are staged to take over at the end of the
+   * current PWM period, together with the duty rescaled to the new bit depth,
+   * so the light doesn't change. A running fade is stopped where it is.
+   * Moving to another timer (this one is shared with other outputs) can cut
+   * one period short.
+   *
+   * @return false, keeping the current plan, if it can't be run.
+   */
+  bool switch_plan(const TimerPlan &plan);
 
-  /// Setup LEDC.
+  /** Setup LEDC.
+   *
+   * Only the first call works anything out. After that it just checks the
+   * registers, and rewrites the cached timer and channel config if the
+   * peripheral was powered down in light sleep.
+   */
   void setup();
   void dump_config();
 
   /// Override FloatOutput's write_state.
   void write_state(float state) override;
 
+  /** Write a duty count straight to the hardware.
+   *
+   * Nothing is applied, not even the pin inversion; it's for duties that have
+   * already been through transform_duty(). Values above max_duty() are
+   * clamped.
+   */
+  void write_duty(uint32_t duty);
+
+  /** Set a duty count through the same min/max power and inversions as
+   * set_level(), without any float maths.
+   */
+  void set_duty_raw(uint32_t duty) {
+    this->write_duty(this->transform_duty(duty, this->max_duty()));
+  }
+
+  /** Write a duty count with DUTY_FRACTION_BITS below the integer part.
+   *
+   * The LEDC timer makes up the fraction by stretching that many of every
+   * 2^DUTY_FRACTION_BITS periods by one count, so the low end of the range
+   * gets steps finer than the bit depth with no CPU involved.
+   */
+  void write_duty_fine(uint32_t duty);
+
+  /** Fade along a piecewise-linear duty path using the LEDC fade engine.
+   *
+   * The CPU is free until the fade finishes, use wait_fade() to block on the
+   * fade-end interrupt. Duties are hardware counts as for write_duty().
+   *
+   * @param points Path to follow, at most MAX_FADE_POINTS long.
+   * @return false if the fade couldn't be started in hardware.
+   */
+  bool start_fade(const FadePoint *points, size_t count);
+
+  /// Block until the running fade finishes, returns false on timeout.
+  bool wait_fade(TickType_t timeout);
+
+  /// Stop the running fade, leaving the duty wherever it got to.
+  void stop_fade();
+
+  bool is_fading() const { return this->fading_; }
+
+  /** Switch off for good: stop the timer and its clock and hold the pin.
+   *
+   * The pin is latched at the off level and the timer paused and released,
+   * along with its clock source, once every output on it has parked, so
+   * nothing in the LEDC is left switching. Any write unparks, or call
+   * unpark() to get it out of the way before the first one.
+   */
+  void park();
+  /// Bring the timer and channel back, with the pin held at off throughout.
+  void unpark();
+  bool is_parked() const { return this->parked_; }
+
+  /** Keep the PWM running through light sleep, or let sleep stop it.
+   *
+   * Holding keeps RC_FAST and the peripheral power domain up while asleep,
+   * which is only worth it while the light is lit. Needs set_sleep_clock().
+   *
+   * @return Whether the output will now keep running in light sleep.
+   */
+  bool hold_in_sleep(bool hold);
+  bool is_held_in_sleep() const { return this->held_in_sleep_; }
+
+  uint8_t get_channel() const { return this->channel_; }
+  /// Timer the allocator gave setup(), NO_TIMER before then.
+  uint8_t get_timer() const { return this->timer_; }
+  /// Bit depth picked by setup(), 0 before then.
+  uint8_t get_bit_depth() const { return this->bit_depth_; }
+  /// Largest duty count at the current bit depth.
+  uint32_t max_duty() const { return (uint32_t(1) << this->bit_depth_) - 1; }
+
+  static constexpr uint8_t NO_CHANNEL = 0xFF;
+  static constexpr uint8_t NO_TIMER = 0xFF;
+
+  static constexpr uint8_t DUTY_FRACTION_BITS = LEDC_LL_FRACTIONAL_BITS;
+
+#if SOC_LEDC_GAMMA_CURVE_FADE_SUPPORTED
+  static constexpr size_t MAX_FADE_POINTS = SOC_LEDC_GAMMA_CURVE_FADE_RANGE_MAX;
+#else
+  static constexpr size_t MAX_FADE_POINTS = 1;
+#endif
+
 protected:
+  uint32_t clock_hz_() const;
+  ledc_clk_cfg_t clock_config_() const;
+  void restore_();
+
   InternalGPIOPin *pin_;
-  uint8_t channel_{};
+  uint8_t channel_{NO_CHANNEL};
+  uint8_t timer_{NO_TIMER};
   uint8_t bit_depth_{};
   float phase_angle_{0.0f};
   float frequency_{};
+  TimerPlan plan_{};
+  bool plan_fixed_ = false;
   float duty_{0.0f};
+  /// Last duty written, with DUTY_FRACTION_BITS, for rescaling.
+  uint64_t duty_fine_{0};
   bool initialized_ = false;
+  bool fading_ = false;
+  bool sleep_clock_ = false;
+  bool held_in_sleep_ = false;
+  bool parked_ = false;
+  SemaphoreHandle_t fade_done_{nullptr};
+  ledc_timer_config_t timer_conf_{};
+  /// Kept for restoring after sleep. Its hpoint is the one every duty write
+  /// uses, so it's kept up to date with the phase and bit depth.
+  ledc_channel_config_t chan_conf_{};
+  /// allocator.reset_count() when this channel was last set up.
+  uint32_t reset_count_{0};
+};
+
+/** Several strings with their pulses spread evenly over the period.
+ *
+ * With every string switching on at the start of the period their currents
+ * stack into one tall pulse; staggered, the conduction windows interleave and
+ * the cell and boost stage see a lower peak and ripple for the same mean
+ * current (see model_string_current()). Phases only line up between outputs
+ * running off the same timer, which outputs at the same frequency and clock
+ * get from the allocator.
+ */
+class StaggeredStrings {
+public:
+  /// Add a string and respread the phases of all of them, false if full.
+  bool add(LEDCOutput *output);
+
+  size_t size() const { return this->count_; }
+  LEDCOutput *get(size_t index) const { return this->outputs_[index]; }
+
+  /// Model the current drawn at the given duties, one per string, once the
+  /// strings are set up and have a bit depth.
+  CurrentStats model_current(const uint32_t *duties, uint32_t string_ma) const;
+
+protected:
+  LEDCOutput *outputs_[CHANNEL_COUNT]{};
+  size_t count_{0};
 };
 
 } // namespace ledc
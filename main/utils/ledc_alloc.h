@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include <soc/soc_caps.h>
+
+#include "ledc_plan.h"
+
+namespace ledc {
+
+static constexpr uint8_t CHANNEL_COUNT = SOC_LEDC_CHANNEL_NUM;
+static constexpr uint8_t TIMER_COUNT = SOC_LEDC_TIMER_NUM;
+
+/// What an output got from acquire_timer().
+struct TimerGrant {
+  uint8_t timer;
+  /// Whether the timer still has to be configured, i.e. nothing else is
+  /// already running it with this plan.
+  bool configure;
+  /// Whether the timer moved off by retune_timer() is left with nothing
+  /// running on it, so should be stopped.
+  bool stop_previous{false};
+};
+
+/** Hands out LEDC channels and timers.
+ *
+ * Outputs with the same timer plan share a timer, so the four timers go as
+ * far as they can across six channels. All the timers take their clock from
+ * one source, so a plan on a different clock from the timers already in use
+ * is refused rather than silently retuning them. Anything that can't be
+ * satisfied gets nothing rather than aliasing an existing output.
+ *
+ * A timer is stopped once every output on it has parked, and stays stopped
+ * until one of them unparks or a new output joins it; whoever that is gets
+ * told to configure it again.
+ *
+ * Pure bookkeeping, the driver calls are left to the output.
+ */
+class Allocator {
+public:
+  /// Take the lowest free channel.
+  std::optional<uint8_t> allocate_channel() {
+    for (uint8_t channel = 0; channel < CHANNEL_COUNT; channel++) {
+      if (this->claim_channel(channel))
+        return channel;
+    }
+    return {};
+  }
+
+  /// Take a specific channel, false if it's taken or doesn't exist.
+  bool claim_channel(uint8_t channel) {
+    if (channel >= CHANNEL_COUNT || this->channel_used_(channel))
+      return false;
+    this->channels_ |= 1U << channel;
+    return true;
+  }
+
+  void release_channel(uint8_t channel) {
+    if (channel < CHANNEL_COUNT)
+      this->channels_ &= ~(1U << channel);
+  }
+
+  /// Share a timer already running the plan, otherwise take a free one.
+  std::optional<TimerGrant> acquire_timer(const TimerPlan &plan) {
+    if (!this->clock_fits_(plan, TIMER_COUNT))
+      return {};
+
+    for (uint8_t timer = 0; timer < TIMER_COUNT; timer++) {
+      if (this->users_[timer] != 0 && this->same_plan_(timer, plan))
+        return this->join_(timer);
+    }
+    for (uint8_t timer = 0; timer < TIMER_COUNT; timer++) {
+      if (this->users_[timer] == 0)
+        return this->claim_(timer, plan);
+    }
+    return {};
+  }
+
+  /** Move from one timer to another running a new plan.
+   *
+   * A timer nobody else is using is retuned in place. On failure the output
+   * keeps the timer it had. The output must not be parked, unpark it first.
+   */
+  std::optional<TimerGrant> retune_timer(uint8_t timer, const TimerPlan &plan) {
+    if (timer >= TIMER_COUNT || this->users_[timer] == 0)
+      return this->acquire_timer(plan);
+    if (this->same_plan_(timer, plan))
+      return TimerGrant{timer, false};
+    if (!this->clock_fits_(plan, timer))
+      return {};
+
+    for (uint8_t other = 0; other < TIMER_COUNT; other++) {
+      if (other != timer && this->users_[other] != 0 &&
+          this->same_plan_(other, plan))
+        return this->leave_(timer, this->join_(other));
+    }
+    if (this->users_[timer] == 1) {
+      this->plans_[timer] = plan;
+      return TimerGrant{timer, true};
+    }
+    for (uint8_t other = 0; other < TIMER_COUNT; other++) {
+      if (this->users_[other] == 0)
+        return this->leave_(timer, this->claim_(other, plan));
+    }
+    return {};
+  }
+
+  void release_timer(uint8_t timer) {
+    if (timer >= TIMER_COUNT || this->users_[timer] == 0)
+      return;
+    this->users_[timer]--;
+    // only the outputs that had parked are left, so it's as they left it
+    if (this->users_[timer] != 0)
+      this->stop_if_idle_(timer);
+  }
+
+  /** Note an output on the timer parking.
+   *
+   * @return Whether every output on it is now parked, so the timer can stop.
+   */
+  bool park_timer(uint8_t timer) {
+    if (timer >= TIMER_COUNT || this->parked_[timer] >= this->users_[timer])
+      return false;
+    this->parked_[timer]++;
+    return this->stop_if_idle_(timer);
+  }
+
+  /// Note an output unparking, true if the timer was stopped and needs
+  /// configuring again.
+  bool unpark_timer(uint8_t timer) {
+    if (timer >= TIMER_COUNT || this->parked_[timer] == 0)
+      return false;
+    this->parked_[timer]--;
+    return this->start_(timer);
+  }
+
+  uint8_t timer_users(uint8_t timer) const {
+    return timer < TIMER_COUNT ? this->users_[timer] : 0;
+  }
+
+  /// Whether the timer was stopped because nothing on it is running.
+  bool timer_stopped(uint8_t timer) const {
+    return timer < TIMER_COUNT && this->stopped_[timer];
+  }
+
+  /** Note an output taking or giving back its hold on the sleep power
+   * domains.
+   *
+   * Mirrors the references esp_sleep_pd_config() keeps, which can't be read
+   * back, so a leaked hold shows in the log.
+   *
+   * @return Holds still taken.
+   */
+  uint8_t note_sleep_hold(bool hold) {
+    if (hold)
+      this->sleep_holds_++;
+    else if (this->sleep_holds_ != 0)
+      this->sleep_holds_--;
+    return this->sleep_holds_;
+  }
+
+  /** Count of times the peripheral has been found reset after sleep.
+   *
+   * The first output to notice restores its timer, which hides the reset from
+   * anything sharing that timer; they compare this instead to know their
+   * channel needs restoring too.
+   */
+  uint32_t reset_count() const { return this->resets_; }
+  void note_reset() { this->resets_++; }
+
+protected:
+  bool channel_used_(uint8_t channel) const {
+    return this->channels_ & (1U << channel);
+  }
+
+  /// Add a user to a timer already running the plan, restarting it if every
+  /// output on it had parked.
+  TimerGrant join_(uint8_t timer) {
+    this->users_[timer]++;
+    return TimerGrant{timer, this->start_(timer)};
+  }
+
+  /// Give an unused timer a plan and its first user.
+  TimerGrant claim_(uint8_t timer, const TimerPlan &plan) {
+    this->users_[timer] = 1;
+    this->parked_[timer] = 0;
+    this->stopped_[timer] = false;
+    this->plans_[timer] = plan;
+    return TimerGrant{timer, true};
+  }
+
+  /// Take a user off the timer it moved from, and pass on whether that
+  /// leaves it to be stopped.
+  TimerGrant leave_(uint8_t timer, TimerGrant grant) {
+    this->users_[timer]--;
+    grant.stop_previous = this->stop_if_idle_(timer);
+    return grant;
+  }
+
+  /// Mark the timer stopped if nothing on it is running, true if it just
+  /// was.
+  bool stop_if_idle_(uint8_t timer) {
+    if (this->stopped_[timer] || this->parked_[timer] != this->users_[timer])
+      return false;
+    this->stopped_[timer] = true;
+    return true;
+  }
+
+  /// Mark the timer running again, true if it was stopped.
+  bool start_(uint8_t timer) {
+    const bool stopped = this->stopped_[timer];
+    this->stopped_[timer] = false;
+    return stopped;
+  }
+
+  bool same_plan_(uint8_t timer, const TimerPlan &plan) const {
+    return same_timer_plan(this->plans_[timer], plan);
+  }
+
+  /// Whether the plan's clock matches every timer in use apart from `except`.
+  bool clock_fits_(const TimerPlan &plan, uint8_t except) const {
+    for (uint8_t timer = 0; timer < TIMER_COUNT; timer++) {
+      if (timer != except && this->users_[timer] != 0 &&
+          this->plans_[timer].clock_hz != plan.clock_hz)
+        return false;
+    }
+    return true;
+  }
+
+  uint32_t channels_{0};
+  uint8_t users_[TIMER_COUNT]{};
+  uint8_t parked_[TIMER_COUNT]{};
+  bool stopped_[TIMER_COUNT]{};
+  TimerPlan plans_[TIMER_COUNT]{};
+  uint32_t resets_{0};
+  uint8_t sleep_holds_{0};
+};
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+extern Allocator allocator;
+
+} // namespace ledc
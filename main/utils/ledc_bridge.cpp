@@ -0,0 +1,83 @@
+#include <cinttypes>
+
+#include <esp_log.h>
+
+#include "ledc_bridge.h"
+
+namespace ledc {
+
+static const char *const TAG = "ledc.bridge";
+
+void BridgeOutput::setup() {
+  if (this->initialized_) {
+    this->forward_->setup();
+    this->reverse_->setup();
+    return;
+  }
+
+  this->forward_->set_phase_angle(0.0f);
+  this->reverse_->set_phase_angle(180.0f);
+  this->forward_->setup();
+  this->reverse_->setup();
+
+  if (this->forward_->get_timer() == LEDCOutput::NO_TIMER ||
+      this->forward_->get_timer() != this->reverse_->get_timer()) {
+    ESP_LOGE(TAG, "Bridge channels %u and %u need to share a timer",
+             this->forward_->get_channel(), this->reverse_->get_channel());
+    return;
+  }
+  if (this->forward_->get_bit_depth() != this->reverse_->get_bit_depth()) {
+    ESP_LOGE(TAG, "Bridge channels have different bit depths");
+    return;
+  }
+  // an inverted or minimum-power channel would be on at zero, shorting the
+  // bridge whenever the other side conducts
+  if (this->forward_->transform_duty(0, 1) != 0 ||
+      this->reverse_->transform_duty(0, 1) != 0) {
+    ESP_LOGE(TAG, "Bridge channels must be off at zero");
+    // a raw 0 would be fully on for an active-low pin, so write whatever
+    // leaves each pin inactive
+    this->forward_->write_duty(
+        this->forward_->pin_off_duty(this->forward_->max_duty()));
+    this->reverse_->write_duty(
+        this->reverse_->pin_off_duty(this->reverse_->max_duty()));
+    return;
+  }
+
+  const auto limits = plan_bridge(this->forward_->get_plan(),
+                                  this->dead_time_ns_, this->budget_permille_);
+  if (!limits.has_value()) {
+    ESP_LOGE(TAG, "Dead time of %" PRIu32 " ns leaves no time to conduct",
+             this->dead_time_ns_);
+    return;
+  }
+
+  this->limits_ = *limits;
+  this->initialized_ = true;
+  this->write_duties(0, 0);
+}
+
+void BridgeOutput::write_duties(uint32_t forward, uint32_t reverse) {
+  if (!this->initialized_) {
+    ESP_LOGW(TAG, "Bridge output hasn't been initialized yet!");
+    return;
+  }
+
+  const BridgeDuties duties =
+      limit_bridge_duties(this->limits_, forward, reverse);
+  this->forward_->write_duty(duties.forward);
+  this->reverse_->write_duty(duties.reverse);
+}
+
+void BridgeOutput::dump_config() {
+  ESP_LOGI(TAG, "Bridge Output:");
+  ESP_LOGI(TAG, "  Channels: %u forward, %u reverse",
+           this->forward_->get_channel(), this->reverse_->get_channel());
+  ESP_LOGI(TAG, "  Dead time: %" PRIu32 " ns", this->dead_time_ns_);
+  ESP_LOGI(TAG, "  Max duty per polarity: %" PRIu32,
+           this->limits_.half_max_duty);
+  ESP_LOGI(TAG, "  Budget: %u.%u%%", this->budget_permille_ / 10,
+           this->budget_permille_ % 10);
+}
+
+} // namespace ledc
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ledc.h"
+#include "ledc_bridge_plan.h"
+
+namespace ledc {
+
+/** Drives a two-wire string of anti-parallel LEDs through an H-bridge.
+ *
+ * Each polarity lights half the bulbs, so the bridge is flipped every PWM
+ * period: the forward channel conducts from the start of the period and the
+ * reverse channel from halfway (phase angles 0° and 180° on a shared timer).
+ * Each gets at most half the period less the dead time, so the two sides of
+ * the bridge are never on together, and each side has its own duty so the
+ * halves can be balanced or animated separately.
+ *
+ * Both channels must be at the same frequency on the same clock, so the
+ * allocator gives them one timer, and neither pin may be inverted.
+ */
+class BridgeOutput {
+public:
+  BridgeOutput(LEDCOutput *forward, LEDCOutput *reverse)
+      : forward_(forward), reverse_(reverse) {}
+
+  /// Gap between one side switching off and the other on, before setup().
+  void set_dead_time_ns(uint32_t dead_time_ns) {
+    this->dead_time_ns_ = dead_time_ns;
+  }
+
+  /** Most of the period the string may conduct for, in total.
+   *
+   * The two halves never conduct at once, so this caps the mean current from
+   * the LED driver. A pair of duties over it are scaled down together,
+   * keeping their balance.
+   */
+  void set_budget_permille(uint16_t budget_permille) {
+    this->budget_permille_ = budget_permille;
+  }
+
+  void setup();
+  void dump_config();
+
+  /// Largest duty either polarity can have, in counts of the full period.
+  uint32_t half_max_duty() const { return this->limits_.half_max_duty; }
+
+  /// Set both polarities' duties, in counts up to half_max_duty().
+  void write_duties(uint32_t forward, uint32_t reverse);
+
+protected:
+  LEDCOutput *forward_;
+  LEDCOutput *reverse_;
+  uint32_t dead_time_ns_{1000};
+  uint16_t budget_permille_{1000};
+  BridgeLimits limits_{};
+  bool initialized_ = false;
+};
+
+} // namespace ledc
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+
+#include "ledc_plan.h"
+#include "pwm_current.h"
+
+namespace ledc {
+
+/// How long each side of a bridge may conduct, in timer counts.
+struct BridgeLimits {
+  /// Largest duty either polarity can have: half the period less the dead
+  /// time.
+  uint32_t half_max_duty;
+  /// Most the two polarities can have between them.
+  uint32_t budget_duty;
+};
+
+/** Work out a bridge's limits for the timer both its channels run on.
+ *
+ * The dead time is rounded up to whole counts, so it's never shorter than
+ * asked. Kept apart from BridgeOutput so it can be built on the host.
+ *
+ * @return Nothing if the dead time leaves no time to conduct.
+ */
+constexpr std::optional<BridgeLimits>
+plan_bridge(const TimerPlan &plan, uint32_t dead_time_ns,
+            uint16_t budget_permille) {
+  const uint64_t period = uint64_t(1) << plan.bit_depth;
+  const uint32_t dead_counts = uint32_t(
+      (uint64_t(dead_time_ns) * plan.frequency_hz * period + 999999999) /
+      1000000000);
+  // where the reverse side starts
+  const uint32_t half = phase_hpoint(180.0f, plan.bit_depth);
+  if (dead_counts >= half)
+    return {};
+  return BridgeLimits{
+      .half_max_duty = half - dead_counts,
+      .budget_duty = uint32_t(
+          period * std::min<uint16_t>(budget_permille, 1000) / 1000)};
+}
+
+/// A duty for each polarity, in counts of the full period.
+struct BridgeDuties {
+  uint32_t forward;
+  uint32_t reverse;
+};
+
+/// Clamp each polarity to its half, then scale both down together if they
+/// go over the budget between them, keeping their balance.
+constexpr BridgeDuties limit_bridge_duties(const BridgeLimits &limits,
+                                           uint32_t forward,
+                                           uint32_t reverse) {
+  forward = std::min(forward, limits.half_max_duty);
+  reverse = std::min(reverse, limits.half_max_duty);
+  const uint32_t total = forward + reverse;
+  if (total > limits.budget_duty) {
+    forward = uint32_t(uint64_t(forward) * limits.budget_duty / total);
+    reverse = uint32_t(uint64_t(reverse) * limits.budget_duty / total);
+  }
+  return {forward, reverse};
+}
+
+} // namespace ledc
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ledc {
+
+/// A point on a piecewise-linear duty path, relative to the start of a fade.
+struct FadePoint {
+  uint32_t time_ms;
+  uint32_t duty;
+};
+
+/** One hardware fade range.
+ *
+ * The LEDC fade engine changes the duty by `scale` every `cycle_num` PWM
+ * cycles, `step_num` times over. This mirrors ledc_fade_param_config_t without
+ * pulling in the driver, so the planner can be built on the host.
+ */
+struct FadeSegment {
+  bool increase;
+  uint16_t cycle_num;
+  uint16_t scale;
+  uint16_t step_num;
+};
+
+/// Largest value the hardware accepts for each of the segment fields.
+static constexpr uint32_t FADE_PARAM_MAX = (1U << 10) - 1;
+
+/** Plan hardware segments for a piecewise-linear duty path.
+ *
+ * Each pair of neighbouring points becomes one segment. Because scale and
+ * step_num are integers the hardware can land a little short of or past a
+ * point, so every segment is planned from where the previous one actually
+ * ended rather than from the requested duty; the error never accumulates.
+ *
+ * @param start_duty Duty the fade starts from.
+ * @param points Path to follow, with increasing times. The first point is the
+ * end of the first segment, not the start of the fade.
+ * @param count Number of points.
+ * @param cycles_per_second PWM frequency, used to turn times into cycles.
+ * @param segments Output, at least `count` entries long.
+ * @return Number of segments written.
+ */
+inline size_t plan_fade_segments(uint32_t start_duty, const FadePoint *points,
+                                 size_t count, uint32_t cycles_per_second,
+                                 FadeSegment *segments) {
+  uint32_t duty = start_duty;
+  uint64_t elapsed_cycles = 0;
+  size_t n = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    const uint64_t end_cycles =
+        uint64_t(points[i].time_ms) * cycles_per_second / 1000;
+    // time the previous segments over- or under-ran is taken from this one
+    const uint32_t cycles = end_cycles > elapsed_cycles
+                                ? uint32_t(end_cycles - elapsed_cycles)
+                                : 1;
+
+    const bool increase = points[i].duty >= duty;
+    const uint32_t delta =
+        increase ? points[i].duty - duty : duty - points[i].duty;
+
+    FadeSegment segment{
+        .increase = increase, .cycle_num = 0, .scale = 0, .step_num = 0};
+    if (delta == 0) {
+      // hold: a zero scale still needs to take up the time
+      uint32_t steps = (cycles + FADE_PARAM_MAX - 1) / FADE_PARAM_MAX;
+      if (steps > FADE_PARAM_MAX)
+        steps = FADE_PARAM_MAX;
+      segment.step_num = steps;
+      segment.scale = 0;
+    } else {
+      uint32_t steps = delta < cycles ? delta : cycles;
+      if (steps > FADE_PARAM_MAX)
+        steps = FADE_PARAM_MAX;
+      if (steps == 0)
+        steps = 1;
+      uint32_t scale = (delta + steps / 2) / steps;
+      if (scale > FADE_PARAM_MAX)
+        scale = FADE_PARAM_MAX;
+      // don't overshoot the point, the next segment starts from here
+      if (scale * steps > delta)
+        steps = delta / scale;
+      if (steps == 0)
+        continue;
+      segment.step_num = steps;
+      segment.scale = scale;
+    }
+
+    uint32_t cycle_num = (cycles + segment.step_num / 2) / segment.step_num;
+    if (cycle_num > FADE_PARAM_MAX)
+      cycle_num = FADE_PARAM_MAX;
+    if (cycle_num == 0)
+      cycle_num = 1;
+    segment.cycle_num = cycle_num;
+
+    const uint32_t change = uint32_t(segment.scale) * segment.step_num;
+    duty = segment.increase ? duty + change : duty - change;
+    elapsed_cycles += uint64_t(cycle_num) * segment.step_num;
+    segments[n++] = segment;
+  }
+
+  return n;
+}
+
+} // namespace ledc
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include <hal/ledc_types.h>
+#include <soc/clk_tree_defs.h>
+
+namespace ledc {
+
+/// Clocks an LEDC timer can be planned against.
+static constexpr uint32_t APB_CLOCK_HZ = 80000000;
+static constexpr uint32_t RC_FAST_CLOCK_HZ = SOC_CLK_RC_FAST_FREQ_APPROX;
+
+static constexpr uint8_t PLAN_MAX_BITS = LEDC_TIMER_BIT_MAX - 1;
+
+/// The timer's clock divider is fixed point with 8 fractional bits, and 10
+/// integer bits.
+static constexpr uint8_t DIVIDER_FRACTION_BITS = 8;
+static constexpr uint32_t DIVIDER_ONE = 1 << DIVIDER_FRACTION_BITS;
+static constexpr uint32_t DIVIDER_MAX = (1 << (10 + DIVIDER_FRACTION_BITS)) - 1;
+
+/// Above this a PWM light doesn't visibly flicker at any modulation depth
+/// (IEEE 1789).
+static constexpr uint32_t FLICKER_FREE_HZ = 3000;
+
+/** A timer frequency and bit depth that the LEDC can actually run. */
+struct TimerPlan {
+  uint32_t clock_hz;
+  uint32_t frequency_hz;
+  uint8_t bit_depth;
+  /// Clock divider in DIVIDER_FRACTION_BITS fixed point. Exactly DIVIDER_ONE
+  /// means every period is the same length, a fractional divider jitters.
+  uint32_t divider;
+
+  constexpr bool is_flicker_free() const {
+    return this->frequency_hz >= FLICKER_FREE_HZ;
+  }
+};
+
+/// Whether two plans set a timer up identically.
+constexpr bool same_timer_plan(const TimerPlan &a, const TimerPlan &b) {
+  return a.clock_hz == b.clock_hz && a.frequency_hz == b.frequency_hz &&
+         a.bit_depth == b.bit_depth && a.divider == b.divider;
+}
+
+/** The same share of full scale at another bit depth.
+ *
+ * Duties carry `fraction_bits` below the count, and full scale at each depth
+ * is max_duty() with those bits, so fully on stays fully on.
+ */
+constexpr uint32_t rescale_duty(uint64_t duty, uint8_t from_bits,
+                                uint8_t to_bits, uint8_t fraction_bits) {
+  const uint64_t from_max = ((uint64_t(1) << from_bits) - 1) << fraction_bits;
+  const uint64_t to_max = ((uint64_t(1) << to_bits) - 1) << fraction_bits;
+  if (from_max == 0)
+    return 0;
+  return uint32_t((duty * to_max + from_max / 2) / from_max);
+}
+
+/// Divider for a frequency and bit depth, 0 if it's out of range.
+constexpr uint32_t plan_divider(uint32_t clock_hz, uint32_t frequency_hz,
+                                uint8_t bit_depth) {
+  const uint64_t counts = uint64_t(frequency_hz) << bit_depth;
+  if (counts == 0 || counts > clock_hz)
+    return 0;
+  const uint64_t divider =
+      ((uint64_t(clock_hz) << DIVIDER_FRACTION_BITS) + counts / 2) / counts;
+  return divider <= DIVIDER_MAX ? uint32_t(divider) : 0;
+}
+
+/// The most resolution a given frequency can have.
+constexpr std::optional<TimerPlan> plan_frequency(uint32_t clock_hz,
+                                                  uint32_t frequency_hz) {
+  for (uint8_t bits = PLAN_MAX_BITS; bits >= 1; bits--) {
+    if ((uint64_t(frequency_hz) << bits) > clock_hz)
+      continue;
+    // fewer bits only makes the divider bigger, so this is the last chance
+    const uint32_t divider = plan_divider(clock_hz, frequency_hz, bits);
+    if (divider == 0)
+      return {};
+    return TimerPlan{clock_hz, frequency_hz, bits, divider};
+  }
+  return {};
+}
+
+/** The most resolution with a frequency of at least min_frequency_hz.
+ *
+ * Runs the timer undivided, at the fastest frequency that resolution allows,
+ * so every period is the same length.
+ */
+constexpr std::optional<TimerPlan>
+plan_max_resolution_above(uint32_t clock_hz, uint32_t min_frequency_hz) {
+  for (uint8_t bits = PLAN_MAX_BITS; bits >= 1; bits--) {
+    const uint32_t frequency = clock_hz >> bits;
+    if (frequency >= min_frequency_hz && frequency > 0)
+      return TimerPlan{clock_hz, frequency, bits, DIVIDER_ONE};
+  }
+  return {};
+}
+
+/// The fastest frequency with a given resolution, if that's flicker free.
+constexpr std::optional<TimerPlan> plan_flicker_free(uint32_t clock_hz,
+                                                     uint8_t bit_depth) {
+  if (bit_depth < 1 || bit_depth > PLAN_MAX_BITS)
+    return {};
+  const TimerPlan plan{clock_hz, clock_hz >> bit_depth, bit_depth,
+                       DIVIDER_ONE};
+  if (!plan.is_flicker_free())
+    return {};
+  return plan;
+}
+
+static_assert(plan_frequency(APB_CLOCK_HZ, 10000)->bit_depth == 12 &&
+                  plan_frequency(APB_CLOCK_HZ, 10000)->divider == 500,
+              "10 kHz should get 12 bits at 80 MHz");
+static_assert(plan_max_resolution_above(APB_CLOCK_HZ, FLICKER_FREE_HZ)
+                      ->bit_depth == 14,
+              "flicker free at 80 MHz should get 14 bits");
+static_assert(!plan_flicker_free(APB_CLOCK_HZ, 16).has_value(),
+              "16 bits at 80 MHz is only 1.2 kHz");
+
+} // namespace ledc
@@ -0,0 +1,173 @@
+#include <cinttypes>
+#include <cstring>
+
+#include <esp_log.h>
+
+#include "pixel_output.h"
+
+namespace rmt {
+
+static const char *const TAG = "rmt.pixels";
+
+// WS2812 timings at a 10 MHz RMT clock, in 0.1 us ticks
+static const uint32_t RESOLUTION_HZ = 10000000;
+static const uint16_t T0H = 3, T0L = 9, T1H = 9, T1L = 3;
+// low for 300 us between frames, enough for the newer parts too
+static const uint16_t RESET_HALF = 1500;
+// how long to wait for the last frame to go out before giving up on it
+static const int SEND_TIMEOUT_MS = 100;
+
+#if SOC_RMT_SUPPORT_DMA
+static const bool USE_DMA = true;
+static const size_t MEM_BLOCK_SYMBOLS = 1024;
+#else
+static const bool USE_DMA = false;
+static const size_t MEM_BLOCK_SYMBOLS = SOC_RMT_MEM_WORDS_PER_CHANNEL;
+#endif
+
+size_t PixelOutput::encode_(rmt_encoder_t *encoder,
+                            rmt_channel_handle_t channel, const void *data,
+                            size_t size, rmt_encode_state_t *ret_state) {
+  auto *wire = reinterpret_cast<WireEncoder *>(encoder);
+  rmt_encode_state_t session = RMT_ENCODING_RESET;
+  int state = RMT_ENCODING_RESET;
+  size_t symbols = 0;
+
+  // picks up wherever the last call ran out of RMT memory
+  if (wire->state == 0) {
+    symbols +=
+        wire->bytes->encode(wire->bytes, channel, data, size, &session);
+    if (session & RMT_ENCODING_COMPLETE)
+      wire->state = 1;
+    if (session & RMT_ENCODING_MEM_FULL) {
+      *ret_state = rmt_encode_state_t(state | RMT_ENCODING_MEM_FULL);
+      return symbols;
+    }
+  }
+  symbols += wire->copy->encode(wire->copy, channel, &wire->reset_code,
+                                sizeof(wire->reset_code), &session);
+  if (session & RMT_ENCODING_COMPLETE) {
+    wire->state = RMT_ENCODING_RESET;
+    state |= RMT_ENCODING_COMPLETE;
+  }
+  if (session & RMT_ENCODING_MEM_FULL)
+    state |= RMT_ENCODING_MEM_FULL;
+  *ret_state = rmt_encode_state_t(state);
+  return symbols;
+}
+
+esp_err_t PixelOutput::reset_(rmt_encoder_t *encoder) {
+  auto *wire = reinterpret_cast<WireEncoder *>(encoder);
+  rmt_encoder_reset(wire->bytes);
+  rmt_encoder_reset(wire->copy);
+  wire->state = RMT_ENCODING_RESET;
+  return ESP_OK;
+}
+
+esp_err_t PixelOutput::del_(rmt_encoder_t *encoder) {
+  auto *wire = reinterpret_cast<WireEncoder *>(encoder);
+  rmt_del_encoder(wire->bytes);
+  rmt_del_encoder(wire->copy);
+  return ESP_OK;
+}
+
+void PixelOutput::setup() {
+  if (this->initialized_)
+    return;
+
+  rmt_tx_channel_config_t chan_conf = {};
+  chan_conf.gpio_num = this->pin_->get_pin();
+  chan_conf.clk_src = RMT_CLK_SRC_DEFAULT;
+  chan_conf.resolution_hz = RESOLUTION_HZ;
+  chan_conf.mem_block_symbols = MEM_BLOCK_SYMBOLS;
+  // one frame sending and the next queued behind it
+  chan_conf.trans_queue_depth = 2;
+  chan_conf.flags.invert_out = this->pin_->is_inverted();
+  chan_conf.flags.with_dma = USE_DMA;
+  esp_err_t err = rmt_new_tx_channel(&chan_conf, &this->channel_);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Unable to set up RMT on pin %u: %s", this->pin_->get_pin(),
+             esp_err_to_name(err));
+    return;
+  }
+
+  rmt_bytes_encoder_config_t bytes_conf = {};
+  bytes_conf.bit0.level0 = 1;
+  bytes_conf.bit0.duration0 = T0H;
+  bytes_conf.bit0.level1 = 0;
+  bytes_conf.bit0.duration1 = T0L;
+  bytes_conf.bit1.level0 = 1;
+  bytes_conf.bit1.duration0 = T1H;
+  bytes_conf.bit1.level1 = 0;
+  bytes_conf.bit1.duration1 = T1L;
+  bytes_conf.flags.msb_first = 1;
+  rmt_copy_encoder_config_t copy_conf = {};
+  err = rmt_new_bytes_encoder(&bytes_conf, &this->encoder_.bytes);
+  if (err == ESP_OK)
+    err = rmt_new_copy_encoder(&copy_conf, &this->encoder_.copy);
+  if (err == ESP_OK)
+    err = rmt_enable(this->channel_);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Unable to set up the pixel encoder: %s",
+             esp_err_to_name(err));
+    return;
+  }
+  this->encoder_.base.encode = encode_;
+  this->encoder_.base.reset = reset_;
+  this->encoder_.base.del = del_;
+  this->encoder_.reset_code.level0 = 0;
+  this->encoder_.reset_code.duration0 = RESET_HALF;
+  this->encoder_.reset_code.level1 = 0;
+  this->encoder_.reset_code.duration1 = RESET_HALF;
+
+  for (auto &buffer : this->buffers_) {
+    buffer = new uint8_t[this->frame_bytes_()];
+    memset(buffer, 0, this->frame_bytes_());
+  }
+  this->initialized_ = true;
+}
+
+bool PixelOutput::show() {
+  if (!this->initialized_) {
+    ESP_LOGW(TAG, "Pixel output hasn't been initialized yet!");
+    return false;
+  }
+
+  uint8_t *back = this->back_buffer();
+  if (this->sent_any_ &&
+      memcmp(back, this->buffers_[this->front_], this->frame_bytes_()) == 0) {
+    this->frames_skipped_++;
+    return false;
+  }
+
+  // the front buffer is about to be handed back for rendering into, so it
+  // has to have finished going out
+  if (this->sent_any_ &&
+      rmt_tx_wait_all_done(this->channel_, SEND_TIMEOUT_MS) != ESP_OK) {
+    ESP_LOGW(TAG, "Last frame didn't finish sending");
+    return false;
+  }
+
+  rmt_transmit_config_t tx_conf = {};
+  esp_err_t err = rmt_transmit(this->channel_, &this->encoder_.base, back,
+                               this->frame_bytes_(), &tx_conf);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Unable to send frame: %s", esp_err_to_name(err));
+    return false;
+  }
+  this->front_ ^= 1;
+  this->sent_any_ = true;
+  this->frames_sent_++;
+  return true;
+}
+
+void PixelOutput::dump_config() {
+  ESP_LOGI(TAG, "Pixel Output:");
+  LOG_PIN("  Pin ", this->pin_);
+  ESP_LOGI(TAG, "  Pixels: %u", (unsigned)this->count_);
+  ESP_LOGI(TAG, "  DMA: %s", USE_DMA ? "yes" : "no");
+  ESP_LOGI(TAG, "  Frames sent: %" PRIu32 ", skipped: %" PRIu32,
+           this->frames_sent_, this->frames_skipped_);
+}
+
+} // namespace rmt
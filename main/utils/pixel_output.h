@@ -0,0 +1,74 @@
+#include "gpio.h"
+#include <cstddef>
+#include <cstdint>
+
+#include <driver/rmt_tx.h>
+#include <soc/soc_caps.h>
+
+#pragma once
+
+namespace rmt {
+
+/** Streams frames to a WS2812-style addressable string over RMT.
+ *
+ * Double buffered: the next frame is rendered into the back buffer while the
+ * RMT is still sending the front one, and show() swaps them. A frame that's
+ * the same as the one last sent is skipped, so a steady string costs no
+ * transmits at all. The pixel data goes out through an encoder that turns
+ * each byte into bit timings in the RMT's own memory, with DMA where the chip
+ * has it for the RMT (the C6 doesn't, it refills from the interrupt).
+ *
+ * Bytes are in wire order, GRB, as light::PixelFrame renders them.
+ */
+class PixelOutput {
+public:
+  PixelOutput(InternalGPIOPin *pin, size_t count) : pin_(pin), count_(count) {}
+
+  void setup();
+  void dump_config();
+
+  size_t size() const { return this->count_; }
+
+  /// Where to render the next frame, 3 bytes per pixel.
+  uint8_t *back_buffer() { return this->buffers_[this->front_ ^ 1]; }
+
+  /** Send the back buffer, unless it's the same as the last frame sent.
+   *
+   * @return Whether a frame was sent.
+   */
+  bool show();
+
+  uint32_t frames_sent() const { return this->frames_sent_; }
+  uint32_t frames_skipped() const { return this->frames_skipped_; }
+
+protected:
+  /// Pixel bytes followed by the reset gap, as one RMT encoder.
+  struct WireEncoder {
+    rmt_encoder_t base;
+    rmt_encoder_handle_t bytes;
+    rmt_encoder_handle_t copy;
+    int state;
+    rmt_symbol_word_t reset_code;
+  };
+
+  static size_t encode_(rmt_encoder_t *encoder, rmt_channel_handle_t channel,
+                        const void *data, size_t size,
+                        rmt_encode_state_t *ret_state);
+  static esp_err_t reset_(rmt_encoder_t *encoder);
+  static esp_err_t del_(rmt_encoder_t *encoder);
+
+  size_t frame_bytes_() const { return this->count_ * 3; }
+
+  InternalGPIOPin *pin_;
+  size_t count_;
+  uint8_t *buffers_[2]{};
+  uint8_t front_{0};
+  bool sent_any_ = false;
+  rmt_channel_handle_t channel_{nullptr};
+  WireEncoder encoder_{};
+  bool initialized_ = false;
+  uint32_t frames_sent_{0};
+  uint32_t frames_skipped_{0};
+};
+
+} // namespace rmt
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace ledc {
+
+/// hpoint for a phase angle in degrees, a fraction of the whole period of
+/// 2^bit_depth counts, so 180° is exactly half way.
+constexpr uint32_t phase_hpoint(float angle, uint8_t bit_depth) {
+  const uint32_t period = uint32_t(1) << bit_depth;
+  return uint32_t(double(angle) * period / 360.0) % period;
+}
+
+/// Phase angle for string `index` of `count` spread evenly round the period.
+constexpr float stagger_angle(size_t index, size_t count) {
+  return count ? 360.0f * index / count : 0.0f;
+}
+
+/// Evenly spaced hpoint for string `index` of `count` sharing a timer.
+constexpr uint32_t stagger_hpoint(size_t index, size_t count,
+                                  uint8_t bit_depth) {
+  return phase_hpoint(stagger_angle(index, count), bit_depth);
+}
+
+static_assert(stagger_hpoint(1, 2, 12) == 2048 &&
+                  stagger_hpoint(1, 3, 12) == 1365 &&
+                  stagger_hpoint(5, 6, 12) == 3413,
+              "staggered hpoints should split the period evenly");
+
+/// One PWM string drawing current_ma while its output is on.
+struct StringLoad {
+  uint32_t hpoint;
+  uint32_t duty;
+  uint32_t current_ma;
+};
+
+/// Current drawn from the cell over one PWM period.
+struct CurrentStats {
+  uint32_t peak_ma;
+  uint32_t mean_ma;
+  uint32_t rms_ma;
+};
+
+/** Model the total current of several strings on one timer.
+ *
+ * Each string conducts from its hpoint for `duty` counts, wrapping round the
+ * end of the period like the LEDC does. With every hpoint the same the
+ * windows stack and the peak is the sum of the strings; staggered, they
+ * interleave and the peak (and the ripple the boost stage sees) drops, while
+ * the mean stays the same. Integer only, so it runs the same on the host.
+ *
+ * @param count At most MAX_STRINGS loads.
+ */
+inline CurrentStats model_string_current(const StringLoad *loads, size_t count,
+                                         uint8_t bit_depth) {
+  static constexpr size_t MAX_STRINGS = 8;
+  struct Edge {
+    uint32_t at;
+    int32_t delta_ma;
+  };
+
+  const uint32_t period = uint32_t(1) << bit_depth;
+  count = std::min(count, MAX_STRINGS);
+
+  Edge edges[MAX_STRINGS * 4];
+  size_t n = 0;
+  int32_t base_ma = 0;
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t duty = std::min(loads[i].duty, period);
+    const int32_t ma = int32_t(loads[i].current_ma);
+    if (duty == 0)
+      continue;
+    if (duty == period) {
+      base_ma += ma;
+      continue;
+    }
+    const uint32_t start = loads[i].hpoint % period;
+    const uint32_t end = start + duty;
+    edges[n++] = {start, ma};
+    if (end <= period) {
+      edges[n++] = {end, -ma};
+    } else {
+      // on from the start of the period too
+      edges[n++] = {period, -ma};
+      edges[n++] = {0, ma};
+      edges[n++] = {end - period, -ma};
+    }
+  }
+  std::sort(edges, edges + n,
+            [](const Edge &a, const Edge &b) { return a.at < b.at; });
+
+  int32_t level_ma = base_ma;
+  uint32_t peak_ma = base_ma;
+  uint64_t charge = 0;
+  uint64_t square = 0;
+  uint32_t at = 0;
+  for (size_t i = 0; i <= n; i++) {
+    const uint32_t next = i < n ? edges[i].at : period;
+    charge += uint64_t(level_ma) * (next - at);
+    square += uint64_t(level_ma) * uint64_t(level_ma) * (next - at);
+    at = next;
+    if (i < n) {
+      level_ma += edges[i].delta_ma;
+      // coincident edges are only a real peak once they've all applied
+      if (i + 1 == n || edges[i + 1].at != at)
+        peak_ma = std::max(peak_ma, uint32_t(level_ma));
+    }
+  }
+
+  // integer square root of the mean square
+  const uint64_t mean_square = square / period;
+  uint64_t rms = 0;
+  for (uint64_t bit = uint64_t(1) << 31; bit != 0; bit >>= 1) {
+    if ((rms | bit) * (rms | bit) <= mean_square)
+      rms |= bit;
+  }
+  return {peak_ma, uint32_t(charge / period), uint32_t(rms)};
+}
+
+} // namespace ledc
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace ledc {
+
+static constexpr size_t EFFICIENCY_MAX_FREQUENCIES = 4;
+static constexpr size_t EFFICIENCY_MAX_BANDS = 6;
+
+/** How efficient the LED driver is at each PWM frequency, by duty band.
+ *
+ * The PWM gates a boost converter, which has to charge its output back up at
+ * the start of every on-time. At low duty the on-times are short and that
+ * restart is most of the energy, so slower PWM wastes less; near full duty
+ * slow PWM lets the output droop further in each gap and pulls harder on the
+ * cell to recover. Where the crossover is depends on the driver, so the map is
+ * filled in per board.
+ */
+struct EfficiencyMap {
+  size_t frequency_count;
+  uint32_t frequency_hz[EFFICIENCY_MAX_FREQUENCIES];
+  size_t band_count;
+  /// Top of each band in permille of full duty, ascending, the last 1000.
+  uint16_t band_max_permille[EFFICIENCY_MAX_BANDS];
+  /// Output power over input power in permille, by [band][frequency].
+  uint16_t efficiency_permille[EFFICIENCY_MAX_BANDS]
+                              [EFFICIENCY_MAX_FREQUENCIES];
+
+  constexpr size_t band_for(uint32_t duty_permille) const {
+    for (size_t band = 0; band + 1 < this->band_count; band++) {
+      if (duty_permille <= this->band_max_permille[band])
+        return band;
+    }
+    return this->band_count - 1;
+  }
+
+  constexpr uint16_t efficiency(size_t band, size_t frequency) const {
+    return this->efficiency_permille[band][frequency];
+  }
+
+  /// The most efficient frequency for a band, the faster one on a tie.
+  constexpr size_t best_frequency(size_t band) const {
+    size_t best = 0;
+    for (size_t frequency = 1; frequency < this->frequency_count;
+         frequency++) {
+      if (this->efficiency(band, frequency) >= this->efficiency(band, best))
+        best = frequency;
+    }
+    return best;
+  }
+
+  constexpr std::optional<size_t> frequency_index(uint32_t hz) const {
+    for (size_t frequency = 0; frequency < this->frequency_count;
+         frequency++) {
+      if (this->frequency_hz[frequency] == hz)
+        return frequency;
+    }
+    return {};
+  }
+};
+
+/// Placeholder figures for a small boost driver gated by its enable pin, not
+/// measured on any board. They're only the shape to expect, so nothing should
+/// switch frequencies on them; measure the board's own driver and replace
+/// them first.
+static constexpr EfficiencyMap DEFAULT_EFFICIENCY_MAP = {
+    .frequency_count = 4,
+    .frequency_hz = {3000, 5000, 10000, 20000},
+    .band_count = 4,
+    .band_max_permille = {50, 150, 400, 1000},
+    .efficiency_permille = {{700, 640, 520, 380},
+                            {780, 750, 690, 600},
+                            {830, 835, 820, 780},
+                            {820, 845, 865, 855}},
+};
+
+/** Picks the PWM frequency for the level the light is settling at.
+ *
+ * Moving costs a timer retune, so the frequency only changes when the new one
+ * is at least the hysteresis more efficient than the one already running, and
+ * a level sitting on the edge of a band doesn't flip back and forth.
+ */
+class ProfilePolicy {
+public:
+  /// Starts on the best frequency for full duty.
+  explicit ProfilePolicy(const EfficiencyMap &map)
+      : map_(map), current_(map.best_frequency(map.band_count - 1)) {}
+
+  void set_hysteresis_permille(uint16_t hysteresis) {
+    this->hysteresis_permille_ = hysteresis;
+  }
+
+  /// The frequency for a duty, which becomes the current one.
+  uint32_t select(uint32_t duty_permille) {
+    const size_t band = this->map_.band_for(duty_permille);
+    const size_t best = this->map_.best_frequency(band);
+    if (this->map_.efficiency(band, best) >=
+        this->map_.efficiency(band, this->current_) +
+            this->hysteresis_permille_)
+      this->current_ = best;
+    return this->frequency_hz();
+  }
+
+  uint32_t frequency_hz() const {
+    return this->map_.frequency_hz[this->current_];
+  }
+
+protected:
+  const EfficiencyMap &map_;
+  size_t current_;
+  uint16_t hysteresis_permille_{10};
+};
+
+/// Time spent at one level over a day.
+struct DailyLevel {
+  uint16_t duty_permille;
+  uint16_t minutes;
+};
+
+/// An evening of fairy lights: full for an hour, dimmed through the evening,
+/// then a night light until morning.
+static constexpr DailyLevel TYPICAL_DAY[] = {
+    {1000, 60},
+    {400, 180},
+    {100, 120},
+    {30, 420},
+};
+
+/** Battery energy a day takes, in arbitrary units.
+ *
+ * Output power is taken as proportional to duty, and divided by the driver's
+ * efficiency at that level. Off and the rest of the board aren't counted.
+ *
+ * @param fixed_frequency Frequency index to run everything at, or nothing to
+ * use the best for each level as ProfilePolicy would once settled.
+ */
+constexpr uint64_t model_daily_draw(const EfficiencyMap &map,
+                                    const DailyLevel *levels, size_t count,
+                                    std::optional<size_t> fixed_frequency) {
+  uint64_t draw = 0;
+  for (size_t i = 0; i < count; i++) {
+    const size_t band = map.band_for(levels[i].duty_permille);
+    const size_t frequency = fixed_frequency.has_value()
+                                 ? *fixed_frequency
+                                 : map.best_frequency(band);
+    const uint16_t efficiency = map.efficiency(band, frequency);
+    if (efficiency == 0)
+      continue;
+    draw += uint64_t(levels[i].duty_permille) * levels[i].minutes * 1000 /
+            efficiency;
+  }
+  return draw;
+}
+
+/// How much longer the battery lasts picking frequencies by level than fixed
+/// at one, in permille.
+constexpr uint32_t model_runtime_gain_permille(const EfficiencyMap &map,
+                                               const DailyLevel *levels,
+                                               size_t count,
+                                               size_t fixed_frequency) {
+  const uint64_t fixed = model_daily_draw(map, levels, count, fixed_frequency);
+  const uint64_t selected = model_daily_draw(map, levels, count, {});
+  if (selected == 0 || fixed <= selected)
+    return 0;
+  return uint32_t(fixed * 1000 / selected - 1000);
+}
+
+static_assert(DEFAULT_EFFICIENCY_MAP.best_frequency(0) == 0 &&
+                  DEFAULT_EFFICIENCY_MAP.best_frequency(3) == 2,
+              "dim should run slow and bright at 10 kHz");
+
+} // namespace ledc
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace output {
+
+namespace detail {
+
+// constexpr replacements for std::log/std::exp, accurate to well below one
+// part in 2^16 over (0, 1], which is all the gamma table needs.
+
+constexpr double cx_log(double x) {
+  // reduce x to [1, 2) * 2^exponent
+  int exponent = 0;
+  while (x >= 2.0) {
+    x /= 2.0;
+    exponent++;
+  }
+  while (x < 1.0) {
+    x *= 2.0;
+    exponent--;
+  }
+
+  // ln(x) = 2 * atanh((x - 1) / (x + 1))
+  const double y = (x - 1.0) / (x + 1.0);
+  const double y2 = y * y;
+  double term = y;
+  double sum = 0.0;
+  for (int i = 1; i < 40; i += 2) {
+    sum += term / i;
+    term *= y2;
+  }
+  return 2.0 * sum + exponent * 0.69314718055994530942;
+}
+
+constexpr double cx_exp(double x) {
+  // exp(x) = 2^k * exp(r), |r| <= ln(2) / 2
+  const double ln2 = 0.69314718055994530942;
+  int k = static_cast<int>(x / ln2 + (x < 0 ? -0.5 : 0.5));
+  const double r = x - k * ln2;
+
+  double term = 1.0;
+  double sum = 1.0;
+  for (int i = 1; i < 20; i++) {
+    term *= r / i;
+    sum += term;
+  }
+
+  for (; k > 0; k--)
+    sum *= 2.0;
+  for (; k < 0; k++)
+    sum /= 2.0;
+  return sum;
+}
+
+constexpr double cx_pow(double base, double exponent) {
+  if (base <= 0.0)
+    return 0.0;
+  return cx_exp(exponent * cx_log(base));
+}
+
+} // namespace detail
+
+/// Number of entries in a curve table, one per 8-bit level.
+static constexpr size_t CURVE_TABLE_SIZE = 256;
+
+/// Full scale of a curve table entry, and of a 16-bit curve input.
+static constexpr uint32_t CURVE_TABLE_MAX = 0xFFFF;
+
+using CurveTable = std::array<uint16_t, CURVE_TABLE_SIZE>;
+
+// Response curves map an input in [0, 1] to an output in [0, 1]. apply() is
+// only ever run by the compiler, to build the curve's table.
+
+/// Output proportional to input.
+struct LinearCurve {
+  static constexpr double apply(double x) { return x; }
+};
+
+/// x ^ (Numerator / Denominator).
+template <unsigned Numerator, unsigned Denominator = 10> struct PowerCurve {
+  static constexpr double apply(double x) {
+    return detail::cx_pow(x, double(Numerator) / double(Denominator));
+  }
+};
+
+/// Luminance for a CIE 1976 lightness L* of 100 x, so equal steps in the
+/// input look like equal steps in brightness.
+struct CIELightnessCurve {
+  static constexpr double apply(double x) {
+    const double l = x * 100.0;
+    if (l <= 8.0)
+      return l / 903.2962962962963;
+    const double t = (l + 16.0) / 116.0;
+    return t * t * t;
+  }
+};
+
+/// Starts and stops gently, 3x^2 - 2x^3. Meant for easing transitions.
+struct EaseInOutCurve {
+  static constexpr double apply(double x) { return x * x * (3.0 - 2.0 * x); }
+};
+
+/// Gamma used for the fairy light strings.
+using GammaCurve = PowerCurve<28>;
+
+/** Build the table for a curve.
+ *
+ * Entry i is round(Curve::apply(i / 255) * 65535). This is evaluated by the
+ * compiler, so the fade loop only ever does a lookup.
+ */
+template <typename Curve> constexpr CurveTable make_curve_table() {
+  CurveTable table{};
+  for (size_t i = 0; i < CURVE_TABLE_SIZE; i++) {
+    const double x = double(i) / double(CURVE_TABLE_SIZE - 1);
+    table[i] = static_cast<uint16_t>(Curve::apply(x) * CURVE_TABLE_MAX + 0.5);
+  }
+  return table;
+}
+
+/// Each curve that is used gets its own table.
+template <typename Curve>
+inline constexpr CurveTable CURVE_TABLE = make_curve_table<Curve>();
+
+static_assert(CURVE_TABLE<GammaCurve>[0] == 0,
+              "gamma table must start at zero");
+static_assert(CURVE_TABLE<GammaCurve>[CURVE_TABLE_SIZE - 1] == CURVE_TABLE_MAX,
+              "gamma table must end at full scale");
+// pow(128 / 255, 2.8) * 65535 = 9513.68
+static_assert(CURVE_TABLE<GammaCurve>[128] == 9514,
+              "gamma table midpoint is off");
+// L* = 100 * 128 / 255 is a luminance of 0.18583
+static_assert(CURVE_TABLE<CIELightnessCurve>[128] == 12179,
+              "CIE lightness table midpoint is off");
+
+/** Curve output for a 16-bit input, with 8 extra bits below the 16-bit
+ * output.
+ *
+ * Interpolates linearly between table entries. At inputs that are a multiple
+ * of 257 (i.e. exact 8-bit levels) this is the table entry.
+ */
+template <typename Curve> constexpr uint32_t curve_fine_q8(uint16_t x) {
+  if constexpr (std::is_same_v<Curve, LinearCurve>) {
+    return uint32_t(x) << 8;
+  } else {
+    constexpr const CurveTable &table = CURVE_TABLE<Curve>;
+    // position in the table, with 8 bits of it between entries
+    const uint32_t pos =
+        (uint32_t(x) * ((CURVE_TABLE_SIZE - 1) << 8) + CURVE_TABLE_MAX / 2) /
+        CURVE_TABLE_MAX;
+    const uint32_t index = pos >> 8;
+    const uint32_t between = pos & 0xFF;
+    const int32_t lo = table[index];
+    const int32_t hi = index + 1 < CURVE_TABLE_SIZE ? table[index + 1] : lo;
+    return uint32_t((lo << 8) + (hi - lo) * int32_t(between));
+  }
+}
+
+/// Curve output for a 16-bit input, as a 16-bit value.
+template <typename Curve> constexpr uint16_t curve_fine(uint16_t x) {
+  return uint16_t((curve_fine_q8<Curve>(x) + 0x80) >> 8);
+}
+
+/// Duty count for an 8-bit level at the given bit depth.
+///
+/// Rounds to nearest, so full scale maps to exactly (1 << bit_depth) - 1.
+template <typename Curve = GammaCurve>
+constexpr uint32_t curve_duty(uint8_t level, uint8_t bit_depth) {
+  const uint32_t max_duty = (uint32_t(1) << bit_depth) - 1;
+  return static_cast<uint32_t>(
+      (uint64_t(CURVE_TABLE<Curve>[level]) * max_duty + CURVE_TABLE_MAX / 2) /
+      CURVE_TABLE_MAX);
+}
+
+/** Duty for a 16-bit level, keeping `fraction_bits` of the duty below the
+ * integer count.
+ *
+ * Interpolating at the full 16-bit level is what gives slow fades at the
+ * bottom of the range codes to use in between the 8-bit levels. At exact
+ * 8-bit levels this agrees with curve_duty().
+ */
+template <typename Curve = GammaCurve>
+constexpr uint32_t curve_duty_fine(uint16_t level, uint8_t bit_depth,
+                                   uint8_t fraction_bits) {
+  const uint64_t value = curve_fine_q8<Curve>(level);
+  const uint64_t max_duty = ((uint64_t(1) << bit_depth) - 1) << fraction_bits;
+  return static_cast<uint32_t>((value * max_duty + (CURVE_TABLE_MAX << 7)) /
+                               (uint64_t(CURVE_TABLE_MAX) << 8));
+}
+
+static_assert(curve_duty_fine(128 * 257, 12, 0) == curve_duty(128, 12),
+              "fine curve must agree with the table at 8-bit levels");
+static_assert(curve_duty_fine(0xFFFF, 12, 4) == ((1U << 12) - 1) << 4,
+              "fine curve must end at full scale");
+static_assert(curve_duty_fine<LinearCurve>(0x8000, 16, 0) == 0x8000,
+              "linear curve must pass levels straight through");
+
+} // namespace output
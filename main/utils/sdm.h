@@ -0,0 +1,60 @@
+#include "float_output.h"
+#include "isr_gpio.h"
+#include <cinttypes>
+
+#include <driver/sdm.h>
+
+#pragma once
+
+namespace sdm {
+
+/** Dims a pin with the sigma-delta modulator rather than PWM.
+ *
+ * The SDM spreads the on time out as a pulse density rather than one pulse
+ * per PWM period. The density is only 8 bits however many samples a second
+ * it runs, so it trades resolution for frequency: it has more than the LEDC
+ * above 312.5 kHz, where PWM from the 80 MHz clock drops below 8 bits, and
+ * less below that (see test/test_sdm_vs_ledc.cpp for the table, and
+ * test/bench_sdm_vs_ledc.cpp for what a write costs against the LEDC).
+ *
+ * Looks enough like ledc::LEDCOutput for output::CurvedOutput and the
+ * software fade path to drive it; there's no hardware fade and nothing runs
+ * through light sleep.
+ */
+class SDMOutput : public output::FloatOutput {
+public:
+  explicit SDMOutput(InternalGPIOPin *pin) : pin_(pin) {}
+
+  /// Density samples per second, 80 MHz divided down by 1 to 256.
+  void set_sample_rate(uint32_t sample_rate_hz) {
+    this->sample_rate_hz_ = sample_rate_hz;
+  }
+
+  void setup();
+  void dump_config();
+
+  /// Override FloatOutput's write_state.
+  void write_state(float state) override;
+
+  /// Write a raw density, 0 off to max_duty() as far on as the SDM goes.
+  void write_duty(uint32_t duty);
+
+  /// No fractional bits, so this is write_duty().
+  void write_duty_fine(uint32_t duty) { this->write_duty(duty); }
+
+  uint8_t get_bit_depth() const { return BIT_DEPTH; }
+  /// The densest the SDM goes is 255 ones in 256, just short of fully on.
+  uint32_t max_duty() const { return (uint32_t(1) << BIT_DEPTH) - 1; }
+
+  static constexpr uint8_t BIT_DEPTH = 8;
+  static constexpr uint8_t DUTY_FRACTION_BITS = 0;
+
+protected:
+  InternalGPIOPin *pin_;
+  uint32_t sample_rate_hz_{1000000};
+  sdm_channel_handle_t channel_{nullptr};
+  float duty_{0.0f};
+  bool initialized_ = false;
+};
+
+} // namespace sdm
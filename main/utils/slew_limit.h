@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+namespace output {
+
+/** How fast the duty, and so the current from the cell, may change.
+ *
+ * A step from off to full pulls the boost converter's whole load out of the
+ * battery at once, and a weak cell sags far enough under that to brown out.
+ * The limit is the shortest time a full-scale change may take, which gets
+ * longer as the battery runs down. At full charge it's short enough that a
+ * limited step still looks instant.
+ */
+class SlewLimit {
+public:
+  /// Shortest full-scale change at good, low and critical battery.
+  void set_full_scale_ms(uint32_t good_ms, uint32_t low_ms,
+                         uint32_t critical_ms) {
+    this->good_ms_ = good_ms;
+    this->low_ms_ = low_ms;
+    this->critical_ms_ = critical_ms;
+  }
+
+  /// Pick the limit for the battery's state of charge.
+  void set_battery_percent(uint8_t percent) {
+    this->battery_percent_ = percent;
+  }
+
+  uint32_t full_scale_ms() const {
+    if (this->battery_percent_ < CRITICAL_PERCENT)
+      return this->critical_ms_;
+    if (this->battery_percent_ < LOW_PERCENT)
+      return this->low_ms_;
+    return this->good_ms_;
+  }
+
+  /// Shortest time a duty change of delta out of full_scale may take.
+  uint32_t min_ms(uint32_t delta, uint32_t full_scale) const {
+    if (full_scale == 0)
+      return 0;
+    return uint32_t((uint64_t(delta) * this->full_scale_ms() + full_scale - 1) /
+                    full_scale);
+  }
+
+  static constexpr uint8_t LOW_PERCENT = 30;
+  static constexpr uint8_t CRITICAL_PERCENT = 10;
+
+protected:
+  uint32_t good_ms_{30};
+  uint32_t low_ms_{100};
+  uint32_t critical_ms_{250};
+  uint8_t battery_percent_{100};
+};
+
+} // namespace output
@@ -277,6 +277,10 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
   case ESP_ZB_CORE_SET_ATTR_VALUE_CB_ID:
     ret = zb_attribute_handler((esp_zb_zcl_set_attr_value_message_t *)message);
     break;
+  case ESP_ZB_CORE_CMD_PRIVILEGE_COMMAND_REQ_CB_ID:
+    zigbeeC->handle_command(
+        (const esp_zb_zcl_privilege_command_message_t *)message);
+    break;
   case ESP_ZB_CORE_CMD_DEFAULT_RESP_CB_ID:
     ESP_LOGD(TAG, "Receive Zigbee default response callback");
     break;
@@ -298,6 +302,29 @@ void ZigBeeComponent::handle_attribute(esp_zb_device_cb_common_info_t info,
   }
 }
 
+void ZigBeeComponent::add_command_handler(
+    uint8_t endpoint_id, uint16_t cluster_id, uint8_t command_id,
+    std::function<void(const uint8_t *payload, uint16_t size)> &&callback) {
+  this->command_handlers_[{endpoint_id, cluster_id, command_id}].add(
+      std::move(callback));
+}
+
+void ZigBeeComponent::handle_command(
+    const esp_zb_zcl_privilege_command_message_t *message) {
+  ESP_LOGD(TAG,
+           "Received command: endpoint(%d), cluster(0x%x), command(0x%x), "
+           "data size(%d)",
+           message->info.dst_endpoint, message->info.cluster,
+           message->info.command.id, message->size);
+  auto it = this->command_handlers_.find({message->info.dst_endpoint,
+                                          message->info.cluster,
+                                          message->info.command.id});
+  if (it != this->command_handlers_.end()) {
+    it->second.call(static_cast<const uint8_t *>(message->data),
+                    message->size);
+  }
+}
+
 void ZigBeeComponent::create_default_cluster(
     uint8_t endpoint_id, esp_zb_ha_standard_devices_t device_id) {
   this->cluster_list_[endpoint_id] =
@@ -453,6 +480,17 @@ void ZigBeeComponent::esp_zb_task_() {
   }
   esp_zb_core_action_handler_register(zb_action_handler);
 
+  // commands the application handles itself
+  for (auto const &[key, val] : this->command_handlers_) {
+    if (esp_zb_zcl_add_privilege_command(std::get<0>(key), std::get<1>(key),
+                                         std::get<2>(key)) != ESP_OK) {
+      ESP_LOGE(TAG,
+               "Could not take over command 0x%02X in cluster 0x%04X in "
+               "endpoint %u",
+               std::get<2>(key), std::get<1>(key), std::get<0>(key));
+    }
+  }
+
   // reporting
   for (auto reporting_info : this->reporting_list) {
     ESP_LOGI(TAG, "set reporting for cluster: %u", reporting_info.cluster_id);
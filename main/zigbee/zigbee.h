@@ -105,6 +105,16 @@ public:
   void handle_attribute(esp_zb_device_cb_common_info_t info,
                         esp_zb_zcl_attribute_t attribute);
 
+  /** Handle a cluster command in the application instead of the stack.
+   *
+   * Must be called before setup(). The callback runs in the Zigbee task with
+   * the command payload, after the ZCL header.
+   */
+  void add_command_handler(
+      uint8_t endpoint_id, uint16_t cluster_id, uint8_t command_id,
+      std::function<void(const uint8_t *payload, uint16_t size)> &&callback);
+  void handle_command(const esp_zb_zcl_privilege_command_message_t *message);
+
   void reset() {
     esp_zb_lock_acquire(portMAX_DELAY);
     esp_zb_factory_reset();
@@ -139,6 +149,9 @@ protected:
       attribute_list_;
   std::map<std::tuple<uint8_t, uint16_t, uint8_t, uint16_t>, ZigBeeAttribute *>
       attributes_;
+  std::map<std::tuple<uint8_t, uint16_t, uint8_t>,
+           CallbackManager<void(const uint8_t *, uint16_t)>>
+      command_handlers_;
   esp_zb_nwk_device_type_t device_role_ = ESP_ZB_DEVICE_TYPE_ED;
   esp_zb_ep_list_t *esp_zb_ep_list_ = esp_zb_ep_list_create();
   struct {
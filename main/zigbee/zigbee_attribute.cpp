@@ -20,6 +20,15 @@ void ZigBeeAttribute::set_attr(void *value_p) {
   esp_zb_lock_release();
 }
 
+void ZigBeeAttribute::set_attr_in_callback(void *value_p) {
+  esp_zb_zcl_status_t state =
+      esp_zb_zcl_set_attribute_val(this->endpoint_id_, this->cluster_id_,
+                                   this->role_, this->attr_id_, value_p, false);
+  if (state != ESP_ZB_ZCL_STATUS_SUCCESS) {
+    ESP_LOGE(TAG, "Setting attribute failed!");
+  }
+}
+
 void ZigBeeAttribute::set_report() {
   this->zb_->set_report(this->endpoint_id_, this->cluster_id_, this->role_,
                         this->attr_id_);
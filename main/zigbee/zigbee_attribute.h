@@ -18,6 +18,9 @@ public:
   template <typename T> void add_attr(uint8_t attr_access, T value_p);
   void set_report();
   void set_attr(void *value_p);
+  /// Set the attribute from inside a Zigbee callback, where the stack lock
+  /// is already held.
+  void set_attr_in_callback(void *value_p);
 
   uint8_t attr_type() { return attr_type_; }
 
@@ -0,0 +1,39 @@
+#include <algorithm>
+
+#include "check.h"
+#include "light/effects.h"
+
+using namespace light;
+
+// An hour of each effect: how often the LED task has to wake for it, against
+// the 60 Hz frame tick it replaced, and what generating each step costs.
+int main() {
+  static constexpr uint64_t HOUR_MS = 3600 * 1000;
+  static constexpr uint64_t TICK_WAKEUPS = HOUR_MS * 60 / 1000;
+  static const char *const NAMES[] = {"none", "twinkle", "breathe", "candle"};
+
+  std::printf("%-8s %9s %9s %8s %8s %9s\n", "effect", "wakeups", "vs 60Hz",
+              "min ms", "mean ms", "cycles");
+  for (uint8_t e = EFFECT_TWINKLE; e < EFFECT_COUNT; e++) {
+    EffectEngine engine;
+    engine.start(Effect(e), 1);
+
+    uint64_t elapsed_ms = 0;
+    uint64_t steps = 0;
+    uint32_t min_ms = UINT32_MAX;
+    uint64_t cycles = 0;
+    while (elapsed_ms < HOUR_MS) {
+      const uint64_t start = check::cycles();
+      const EffectStep step = engine.next();
+      cycles += check::cycles() - start;
+      check::keep(step);
+      elapsed_ms += step.duration_ms;
+      min_ms = std::min(min_ms, step.duration_ms);
+      steps++;
+    }
+    std::printf("%-8s %9llu %8.1f%% %8u %8.1f %9.1f\n", NAMES[e],
+                (unsigned long long)steps, 100.0 * steps / TICK_WAKEUPS,
+                min_ms, double(elapsed_ms) / steps, double(cycles) / steps);
+  }
+  return 0;
+}
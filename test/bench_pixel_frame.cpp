@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <vector>
+
+#include "check.h"
+#include "light/pixel_frame.h"
+
+using namespace light;
+
+// Render cost per frame for a string of pixels, mid-fade so every pixel
+// blends, at the lengths a string of fairy lights comes in.
+int main() {
+  static constexpr size_t LENGTHS[] = {50, 200, 1000};
+  static constexpr int FRAMES = 2000;
+
+  std::printf("%7s %12s %12s %10s\n", "pixels", "cycles/frame", "best frame",
+              "cyc/pixel");
+  for (const size_t count : LENGTHS) {
+    std::vector<Pixel> from(count), to(count);
+    std::vector<uint8_t> out(count * 3);
+    PixelFrame<> frame(from.data(), to.data(), count);
+    Rng rng(1);
+
+    PixelFrame<>::fill(frame.retarget(0), count, pixel_rgb(255, 180, 60));
+    frame.fade_to(1, 0);
+    frame.render(1, 256, out.data());
+    PixelFrame<>::twinkle(frame.retarget(1), count, pixel_rgb(255, 180, 60),
+                          128, rng);
+    frame.fade_to(FRAMES * 2, 1);
+
+    uint64_t cycles = 0;
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < FRAMES; i++) {
+      const uint64_t start = check::cycles();
+      frame.render(1 + i, 40 + i % 200, out.data());
+      const uint64_t taken = check::cycles() - start;
+      cycles += taken;
+      best = std::min(best, taken);
+      check::keep(out[i % out.size()]);
+    }
+    // the best frame is the steadier figure on a busy host
+    std::printf("%7zu %12.0f %12llu %10.2f\n", count, double(cycles) / FRAMES,
+                (unsigned long long)best, double(best) / count);
+  }
+  return 0;
+}
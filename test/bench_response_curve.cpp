@@ -0,0 +1,47 @@
+#include <cmath>
+
+#include "check.h"
+#include "utils/response_curve.h"
+
+using namespace output;
+
+// The gamma step the fade loop used to do, against the table lookup that
+// replaced it, both to a 12-bit duty.
+int main() {
+  static constexpr int ROUNDS = 200;
+  static constexpr uint32_t MAX_DUTY = (1 << 12) - 1;
+
+  uint64_t pow_cycles = 0;
+  uint64_t table_cycles = 0;
+  uint64_t fine_cycles = 0;
+  for (int round = 0; round < ROUNDS; round++) {
+    uint64_t start = check::cycles();
+    for (uint32_t level = 0; level < 256; level++) {
+      const double duty = std::pow(level / 255.0, 2.8) * MAX_DUTY;
+      check::keep(duty);
+    }
+    pow_cycles += check::cycles() - start;
+
+    start = check::cycles();
+    for (uint32_t level = 0; level < 256; level++) {
+      const uint32_t duty = curve_duty(uint8_t(level), 12);
+      check::keep(duty);
+    }
+    table_cycles += check::cycles() - start;
+
+    start = check::cycles();
+    for (uint32_t level = 0; level < 0x10000; level += 257) {
+      const uint32_t duty = curve_duty_fine(uint16_t(level), 12, 4);
+      check::keep(duty);
+    }
+    fine_cycles += check::cycles() - start;
+  }
+
+  const double calls = ROUNDS * 256.0;
+  std::printf("std::pow:         %6.1f cycles per level\n", pow_cycles / calls);
+  std::printf("curve_duty:       %6.1f cycles per level\n",
+              table_cycles / calls);
+  std::printf("curve_duty_fine:  %6.1f cycles per level\n",
+              fine_cycles / calls);
+  return 0;
+}
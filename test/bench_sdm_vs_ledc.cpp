@@ -0,0 +1,88 @@
+#include <cstdint>
+
+#include "check.h"
+#include "utils/curved_output.h"
+#include "utils/float_output.h"
+#include "utils/sdm.h"
+
+// The SDM driver, reduced to the register write it ends in.
+static volatile int8_t sdm_density;
+static int sdm_channel;
+
+esp_err_t sdm_new_channel(const sdm_config_t *, sdm_channel_handle_t *ret) {
+  *ret = reinterpret_cast<sdm_channel_handle_t>(&sdm_channel);
+  return ESP_OK;
+}
+esp_err_t sdm_channel_enable(sdm_channel_handle_t) { return ESP_OK; }
+esp_err_t sdm_channel_set_pulse_density(sdm_channel_handle_t, int8_t density) {
+  sdm_density = density;
+  return ESP_OK;
+}
+
+class BenchPin : public InternalGPIOPin {
+public:
+  void setup() override {}
+  void pin_mode(gpio::Flags) override {}
+  bool digital_read() override { return false; }
+  void digital_write(bool) override {}
+  std::string dump_summary() const override { return "bench"; }
+  void detach_interrupt() const override {}
+  ISRInternalGPIOPin to_isr() const override { return {}; }
+  uint8_t get_pin() const override { return 0; }
+  bool is_inverted() const override { return false; }
+
+protected:
+  void attach_interrupt(void (*)(void *), void *,
+                        gpio::InterruptType) const override {}
+};
+
+/** The duty interface of ledc::LEDCOutput at the 12 bits main runs it at,
+ * down to the register write.
+ *
+ * The driver behind it (ledc_set_duty_with_hpoint() and ledc_update_duty())
+ * can't run on the host, so like the SDM's this ends in a plain store.
+ */
+class BenchLEDC : public output::FloatOutput {
+public:
+  void write_state(float) override {}
+  void write_duty_fine(uint32_t duty) { ledc_duty = duty; }
+  uint8_t get_bit_depth() const { return 12; }
+  uint32_t max_duty() const { return (1U << 12) - 1; }
+  static constexpr uint8_t DUTY_FRACTION_BITS = 4;
+
+  volatile uint32_t ledc_duty{0};
+};
+
+template <typename Output>
+static double cycles_per_write(output::CurvedOutput<output::GammaCurve, Output>
+                                   &curve) {
+  static constexpr int ROUNDS = 20;
+  uint64_t best = UINT64_MAX;
+  for (int round = 0; round < ROUNDS; round++) {
+    const uint64_t start = check::cycles();
+    for (uint32_t level = 0; level <= 0xFFFF; level += 7)
+      curve.write_level(uint16_t(level));
+    best = std::min(best, check::cycles() - start);
+  }
+  return double(best) / (0x10000 / 7 + 1);
+}
+
+// What a level write costs through each output, from 16-bit level to the
+// register: the curve, min/max power and inversion, then the output's own
+// conversion.
+int main() {
+  BenchPin pin;
+  sdm::SDMOutput sdm(&pin);
+  sdm.setup();
+  sdm.set_min_power(0.05f);
+  BenchLEDC ledc;
+  ledc.set_min_power(0.05f);
+
+  output::CurvedOutput<output::GammaCurve, sdm::SDMOutput> sdm_curve(&sdm);
+  output::CurvedOutput<output::GammaCurve, BenchLEDC> ledc_curve(&ledc);
+
+  std::printf("%-6s %10s\n", "output", "cycles");
+  std::printf("%-6s %10.1f\n", "SDM", cycles_per_write(sdm_curve));
+  std::printf("%-6s %10.1f\n", "LEDC", cycles_per_write(ledc_curve));
+  return 0;
+}
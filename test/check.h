@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/// Minimal checks for the host tests, each test binary returns failures().
+namespace check {
+
+inline int &failure_count() {
+  static int count = 0;
+  return count;
+}
+
+inline int failures() {
+  if (failure_count() == 0)
+    std::printf("all checks passed\n");
+  else
+    std::printf("%d checks failed\n", failure_count());
+  return failure_count() != 0;
+}
+
+/// Cycle counter for the benchmarks, nanoseconds where there's no TSC.
+inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/// Keep the compiler from optimising a benchmarked result away.
+template <typename T> inline void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace check
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);     \
+      check::failure_count()++;                                                \
+    }                                                                          \
+  } while (0)
+
+#define CHECK_MSG(cond, ...)                                                   \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::printf("%s:%d: CHECK(%s) failed: ", __FILE__, __LINE__, #cond);     \
+      std::printf(__VA_ARGS__);                                                \
+      std::printf("\n");                                                       \
+      check::failure_count()++;                                                \
+    }                                                                          \
+  } while (0)
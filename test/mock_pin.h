@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+/// A pin for host tests, remembering what was written to it.
+struct MockPin {
+  void setup() { this->set_up = true; }
+  void digital_write(bool value) {
+    this->level = value;
+    this->writes++;
+  }
+
+  bool set_up{false};
+  bool level{false};
+  size_t writes{0};
+};
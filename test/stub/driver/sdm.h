@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+#include "esp_err.h"
+
+// The SDM driver's interface, defined by whichever test links it.
+typedef struct sdm_channel_t *sdm_channel_handle_t;
+typedef enum { SDM_CLK_SRC_DEFAULT = 0 } sdm_clock_source_t;
+typedef struct {
+  int gpio_num;
+  sdm_clock_source_t clk_src;
+  uint32_t sample_rate_hz;
+  struct {
+    uint32_t invert_out : 1;
+    uint32_t io_loop_back : 1;
+  } flags;
+} sdm_config_t;
+
+esp_err_t sdm_new_channel(const sdm_config_t *config,
+                          sdm_channel_handle_t *ret_chan);
+esp_err_t sdm_channel_enable(sdm_channel_handle_t chan);
+esp_err_t sdm_channel_set_pulse_density(sdm_channel_handle_t chan,
+                                        int8_t density);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdio>
+
+// Logging compiled out, but with the format still checked against its
+// arguments.
+#define ESP_LOG_STUB(format, ...)                                              \
+  do {                                                                         \
+    if (false)                                                                 \
+      std::printf(format, ##__VA_ARGS__);                                      \
+  } while (0)
+#define ESP_LOGE(tag, format, ...) ESP_LOG_STUB(format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_STUB(format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_STUB(format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_STUB(format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_STUB(format, ##__VA_ARGS__)
@@ -0,0 +1,9 @@
+#pragma once
+
+// Just enough of the IDF's LEDC types for ledc_plan.h on the host, as on the
+// ESP32-C6.
+typedef enum {
+  LEDC_TIMER_1_BIT = 1,
+  LEDC_TIMER_20_BIT = 20,
+  LEDC_TIMER_BIT_MAX,
+} ledc_timer_bit_t;
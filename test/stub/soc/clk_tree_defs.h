@@ -0,0 +1,4 @@
+#pragma once
+
+// RC_FAST on the ESP32-C6.
+#define SOC_CLK_RC_FAST_FREQ_APPROX 17500000
@@ -0,0 +1,5 @@
+#pragma once
+
+// The ESP32-C6's LEDC, for ledc_alloc.h on the host.
+#define SOC_LEDC_CHANNEL_NUM 6
+#define SOC_LEDC_TIMER_NUM 4
@@ -0,0 +1,33 @@
+#include "check.h"
+#include "mock_pin.h"
+#include "utils/gpio_binary_output.h"
+
+static_assert(gpio::OutputPin<MockPin>, "the mock should stand in for a pin");
+static_assert(!gpio::OutputPin<int>, "only pins should be OutputPins");
+
+int main() {
+  MockPin pin;
+  gpio::GPIOBinaryOutput<MockPin> output;
+  output.set_pin(&pin);
+
+  // setup leaves the output off on both sides of setting the pin up
+  output.setup();
+  CHECK(pin.set_up);
+  CHECK(!pin.level);
+  CHECK(pin.writes == 2);
+
+  output.turn_on();
+  CHECK(pin.level);
+  output.set_state(false);
+  CHECK(!pin.level);
+
+  // inverted, on drives the pin low
+  output.set_inverted(true);
+  CHECK(output.is_inverted());
+  output.turn_on();
+  CHECK(!pin.level);
+  output.turn_off();
+  CHECK(pin.level);
+  CHECK(pin.writes == 6);
+  return check::failures();
+}
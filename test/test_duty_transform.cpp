@@ -0,0 +1,99 @@
+#include <cmath>
+
+#include "check.h"
+#include "utils/float_output.h"
+
+using namespace output;
+
+// An output that keeps the level it was last asked to write.
+class TestOutput : public FloatOutput {
+public:
+  using FloatOutput::set_pin_inverted_;
+  float written{-1.0f};
+
+protected:
+  void write_state(float state) override { this->written = state; }
+};
+
+struct Config {
+  float min_power;
+  float max_power;
+  bool zero_means_zero;
+  bool inverted;
+  bool pin_inverted;
+};
+
+// The float path this replaced, applied a stage at a time.
+static float reference(const Config &c, float level) {
+  if (!(level == 0.0f && c.zero_means_zero))
+    level = c.min_power + (c.max_power - c.min_power) * level;
+  if (c.inverted)
+    level = 1.0f - level;
+  if (c.pin_inverted)
+    level = 1.0f - level;
+  return level;
+}
+
+static void check_config(const Config &c) {
+  TestOutput output;
+  output.set_max_power(c.max_power);
+  output.set_min_power(c.min_power);
+  output.set_zero_means_zero(c.zero_means_zero);
+  output.set_inverted(c.inverted);
+  output.set_pin_inverted_(c.pin_inverted);
+
+  for (uint8_t bits : {8, 12, 16}) {
+    const uint32_t full_scale = (1U << bits) - 1;
+    for (uint32_t duty = 0; duty <= full_scale;
+         duty += duty < 8 ? 1 : full_scale / 97) {
+      const float expected = reference(c, float(duty) / full_scale);
+      const uint32_t want = uint32_t(lroundf(expected * full_scale));
+      const uint32_t got = output.transform_duty(duty, full_scale);
+      // Q16 against float, within a count either way
+      CHECK_MSG(got + 1 >= want && got <= want + 1,
+                "min %.2f max %.2f zmz %d inv %d pin %d: %u of %u gave %u, "
+                "want %u",
+                c.min_power, c.max_power, c.zero_means_zero, c.inverted,
+                c.pin_inverted, duty, full_scale, got, want);
+    }
+  }
+
+  for (float level : {0.0f, 0.001f, 0.25f, 0.5f, 0.999f, 1.0f}) {
+    output.set_level(level);
+    CHECK_MSG(std::fabs(output.written - reference(c, level)) < 1e-4f,
+              "level %.3f gave %.5f, want %.5f", level, output.written,
+              reference(c, level));
+  }
+}
+
+int main() {
+  for (float min_power : {0.0f, 0.1f, 0.5f}) {
+    for (float max_power : {1.0f, 0.8f, 0.5f}) {
+      for (int flags = 0; flags < 8; flags++) {
+        check_config({min_power, max_power, bool(flags & 1), bool(flags & 2),
+                      bool(flags & 4)});
+      }
+    }
+  }
+
+  // zero-means-zero is off at zero however the output is inverted
+  TestOutput output;
+  output.set_min_power(0.2f);
+  output.set_zero_means_zero(true);
+  CHECK(output.transform_duty(0, 4095) == 0);
+  CHECK(output.transform_duty(1, 4095) > 800);
+  output.set_inverted(true);
+  CHECK(output.transform_duty(0, 4095) == 4095);
+  output.set_pin_inverted_(true);
+  CHECK(output.transform_duty(0, 4095) == 0);
+
+  // the pin's off level only depends on the pin, not on what the power limits
+  // and output inversion make of a zero
+  TestOutput bridge_side;
+  bridge_side.set_min_power(0.1f);
+  bridge_side.set_inverted(true);
+  CHECK(bridge_side.pin_off_duty(4095) == 0);
+  bridge_side.set_pin_inverted_(true);
+  CHECK(bridge_side.pin_off_duty(4095) == 4095);
+  return check::failures();
+}
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "check.h"
+#include "light/fade.h"
+
+using namespace light;
+
+// Whether the level between now_ms and the end of the fade only ever moves
+// from where it is now towards the target, give or take the one count the
+// fixed point curve can round back by.
+static bool moves_towards_target(const Fade &fade, uint32_t now_ms,
+                                 uint32_t *worst_ms, int32_t *worst_level) {
+  static constexpr int32_t ROUNDING = 1;
+  const int32_t to = fade.target();
+  const bool up = to >= fade.level_at(now_ms);
+  // furthest the level has got so far
+  int32_t furthest = fade.level_at(now_ms);
+  const uint32_t end_ms = now_ms + fade.remaining_ms(now_ms);
+  for (uint32_t t = now_ms; t <= end_ms; t++) {
+    const int32_t level = fade.level_at(t);
+    const bool backwards =
+        up ? level < furthest - ROUNDING : level > furthest + ROUNDING;
+    const bool past = up ? level > to : level < to;
+    if (backwards || past) {
+      *worst_ms = t - now_ms;
+      *worst_level = level;
+      return false;
+    }
+    furthest = up ? std::max(furthest, level) : std::min(furthest, level);
+  }
+  return true;
+}
+
+static void check_reversal(uint16_t from, uint16_t first_to,
+                           uint32_t first_ms, uint32_t retarget_after_ms,
+                           uint16_t to, uint32_t duration_ms) {
+  Fade fade;
+  fade.set(from, 0);
+  fade.retarget(first_to, first_ms, 0);
+  fade.retarget(to, duration_ms, retarget_after_ms);
+  uint32_t at_ms = 0;
+  int32_t level = 0;
+  CHECK_MSG(fade.is_monotonic() &&
+                moves_towards_target(fade, retarget_after_ms, &at_ms, &level),
+            "%u -> %u over %u ms, retargeted to %u over %u ms after %u ms: "
+            "level %d %u ms in",
+            from, first_to, first_ms, to, duration_ms, retarget_after_ms,
+            level, at_ms);
+}
+
+int main() {
+  // a 4 s fade up turned off at half way over 10 s
+  check_reversal(0, LEVEL_MAX, 4000, 2000, 0, 10000);
+  // a 1 s fade up turned off over 5 s
+  check_reversal(0, LEVEL_MAX, 1000, 500, 0, 5000);
+  // a 100 ms fade up turned off over 5 s
+  check_reversal(0, LEVEL_MAX, 100, 50, 0, 5000);
+  // a fade down sent back up
+  check_reversal(LEVEL_MAX, 0, 2000, 1000, LEVEL_MAX, 3000);
+  // speeding a fade up on to a nearer target
+  check_reversal(0, LEVEL_MAX, 4000, 1000, 20000, 10000);
+
+  // and any other retarget
+  srand(1);
+  for (int i = 0; i < 2000; i++) {
+    const uint32_t first_ms = 1 + rand() % 5000;
+    check_reversal(rand() % 0x10000, rand() % 0x10000, first_ms,
+                   rand() % first_ms, rand() % 0x10000, 1 + rand() % 10000);
+  }
+
+  // a retarget in the same direction keeps moving, with no stall
+  Fade fade;
+  fade.set(0, 0);
+  fade.retarget(LEVEL_MAX, 1000, 0);
+  fade.retarget(60000, 100, 500);
+  CHECK(fade.rate_at(500) > 0);
+
+  // stretching a reversal for the slew limit still never overshoots
+  output::SlewLimit limit;
+  limit.set_battery_percent(5);
+  const auto duty = [](uint16_t level) { return uint32_t(level); };
+  for (uint32_t after_ms : {20u, 200u, 900u}) {
+    fade.set(0, 0);
+    fade.retarget(LEVEL_MAX, 1000, 0);
+    const uint32_t duration_ms = slew_limited_ms(fade, 0, 0, after_ms, limit,
+                                                 LEVEL_MAX, duty);
+    fade.retarget(0, duration_ms, after_ms);
+    uint32_t at_ms = 0;
+    int32_t level = 0;
+    CHECK_MSG(moves_towards_target(fade, after_ms, &at_ms, &level),
+              "slew limited reversal after %u ms: level %d %u ms in", after_ms,
+              level, at_ms);
+  }
+  return check::failures();
+}
@@ -0,0 +1,34 @@
+#include "check.h"
+#include "light/frame_clock.h"
+
+using namespace light;
+
+int main() {
+  FrameClock clock;
+  clock.set_overrun_us(16000);
+  clock.start(1000);
+  CHECK(!clock.is_due(999));
+  CHECK(clock.wait_us(0) == 1000);
+
+  // on time, a little late, then late past the threshold
+  clock.frame(1000);
+  clock.schedule(20000);
+  clock.wakeup();
+  clock.frame(25000);
+  clock.schedule(40000);
+  clock.wakeup();
+  clock.wakeup();
+  clock.frame(40000 + 16001);
+
+  const FrameStats &stats = clock.stats();
+  CHECK(stats.frames == 3);
+  CHECK(stats.wakeups == 3);
+  CHECK(stats.overruns == 1);
+  CHECK(stats.max_late_us == 16001);
+  CHECK(stats.mean_late_us() == (5000 + 16001) / 3);
+
+  // a new run starts its counts again
+  clock.start(100000);
+  CHECK(clock.stats().frames == 0 && clock.stats().overruns == 0);
+  return check::failures();
+}
@@ -0,0 +1,106 @@
+#include "check.h"
+#include "utils/ledc_alloc.h"
+
+using namespace ledc;
+
+static constexpr TimerPlan PLAN_A{APB_CLOCK_HZ, 10000, 12, DIVIDER_ONE};
+static constexpr TimerPlan PLAN_B{APB_CLOCK_HZ, 20000, 11, DIVIDER_ONE};
+
+int main() {
+  // joining a timer every output has parked on has to configure it again,
+  // and then the parked output finds it running
+  {
+    Allocator alloc;
+    CHECK(alloc.acquire_timer(PLAN_A)->configure);
+    CHECK(alloc.park_timer(0));
+    CHECK(alloc.timer_stopped(0));
+    const auto grant = alloc.acquire_timer(PLAN_A);
+    CHECK(grant->timer == 0 && grant->configure);
+    CHECK(!alloc.unpark_timer(0));
+  }
+
+  // parking and unparking after another output joined: whoever comes back
+  // to a stopped timer restarts it, exactly once
+  {
+    Allocator alloc;
+    alloc.acquire_timer(PLAN_A);
+    alloc.acquire_timer(PLAN_A);
+    CHECK(!alloc.park_timer(0));
+    CHECK(!alloc.acquire_timer(PLAN_A)->configure);
+    CHECK(!alloc.park_timer(0));
+    CHECK(alloc.park_timer(0));
+    CHECK(alloc.unpark_timer(0));
+    CHECK(!alloc.unpark_timer(0));
+    CHECK(!alloc.unpark_timer(0));
+    CHECK(!alloc.unpark_timer(0));
+  }
+
+  // the last output moving off a timer leaves it to be stopped
+  {
+    Allocator alloc;
+    alloc.acquire_timer(PLAN_A);
+    alloc.acquire_timer(PLAN_B);
+    const auto grant = alloc.retune_timer(0, PLAN_B);
+    CHECK(grant->timer == 1 && !grant->configure && grant->stop_previous);
+    CHECK(alloc.timer_users(0) == 0 && alloc.timer_users(1) == 2);
+  }
+
+  // as does moving off one that only parked outputs are left on, which the
+  // first of them to come back restarts
+  {
+    Allocator alloc;
+    alloc.acquire_timer(PLAN_A);
+    alloc.acquire_timer(PLAN_A);
+    CHECK(!alloc.park_timer(0));
+    const auto grant = alloc.retune_timer(0, PLAN_B);
+    CHECK(grant->timer == 1 && grant->configure && grant->stop_previous);
+    CHECK(alloc.timer_stopped(0));
+    CHECK(alloc.unpark_timer(0));
+  }
+
+  // a timer still driving another output keeps running
+  {
+    Allocator alloc;
+    alloc.acquire_timer(PLAN_A);
+    alloc.acquire_timer(PLAN_A);
+    const auto grant = alloc.retune_timer(0, PLAN_B);
+    CHECK(grant->timer == 1 && grant->configure && !grant->stop_previous);
+    CHECK(!alloc.timer_stopped(0));
+  }
+
+  // retuned in place, there's nothing to stop
+  {
+    Allocator alloc;
+    alloc.acquire_timer(PLAN_A);
+    const auto grant = alloc.retune_timer(0, PLAN_B);
+    CHECK(grant->timer == 0 && grant->configure && !grant->stop_previous);
+  }
+
+  // a stopped timer taken over afresh starts with nothing parked on it
+  {
+    Allocator alloc;
+    alloc.acquire_timer(PLAN_A);
+    alloc.acquire_timer(PLAN_A);
+    alloc.park_timer(0);
+    alloc.retune_timer(0, PLAN_B);
+    alloc.unpark_timer(0);
+    alloc.retune_timer(0, PLAN_B);
+    CHECK(alloc.timer_users(0) == 0);
+    const auto grant = alloc.acquire_timer(TimerPlan{APB_CLOCK_HZ, 5000, 13,
+                                                     DIVIDER_ONE});
+    CHECK(grant->timer == 0 && grant->configure);
+    CHECK(alloc.park_timer(0));
+  }
+
+  // sleep holds pair up, back to none once every output has released
+  {
+    Allocator alloc;
+    CHECK(alloc.note_sleep_hold(true) == 1);
+    CHECK(alloc.note_sleep_hold(true) == 2);
+    CHECK(alloc.note_sleep_hold(false) == 1);
+    CHECK(alloc.note_sleep_hold(false) == 0);
+    CHECK(alloc.note_sleep_hold(false) == 0);
+  }
+
+  return check::failures();
+}
@@ -0,0 +1,53 @@
+#include "check.h"
+#include "utils/ledc_bridge_plan.h"
+
+using namespace ledc;
+
+int main() {
+  // 10 kHz at 12 bits from the 80 MHz clock: 24.4 ns a count
+  const TimerPlan plan = *plan_frequency(APB_CLOCK_HZ, 10000);
+  CHECK(plan.bit_depth == 12);
+
+  // 1 µs of dead time is 40.96 counts, rounded up so it's never shorter
+  const auto limits = plan_bridge(plan, 1000, 1000);
+  CHECK(limits.has_value());
+  CHECK(limits->half_max_duty == 2048 - 41);
+  CHECK(limits->budget_duty == 4096);
+
+  // either side of one count
+  CHECK(plan_bridge(plan, 24, 1000)->half_max_duty == 2048 - 1);
+  CHECK(plan_bridge(plan, 25, 1000)->half_max_duty == 2048 - 2);
+
+  // no dead time, no gap; half the period or more, no time to conduct
+  CHECK(plan_bridge(plan, 0, 1000)->half_max_duty == 2048);
+  CHECK(!plan_bridge(plan, 50000, 1000).has_value());
+  CHECK(!plan_bridge(plan, 49999, 1000).has_value());
+  CHECK(plan_bridge(plan, 49000, 1000).has_value());
+
+  // the budget is a share of the whole period, capped at all of it
+  CHECK(plan_bridge(plan, 1000, 500)->budget_duty == 2048);
+  CHECK(plan_bridge(plan, 1000, 2000)->budget_duty == 4096);
+
+  // each side is clamped to its half, under budget nothing else changes
+  BridgeDuties duties = limit_bridge_duties(*limits, 5000, 100);
+  CHECK(duties.forward == limits->half_max_duty && duties.reverse == 100);
+  duties = limit_bridge_duties(*limits, 0, 0);
+  CHECK(duties.forward == 0 && duties.reverse == 0);
+
+  // over budget both scale down together, keeping their balance, and the
+  // two never add up to more than it
+  const BridgeLimits tight = *plan_bridge(plan, 1000, 600);
+  CHECK(tight.budget_duty == 2457);
+  duties = limit_bridge_duties(tight, 2000, 1000);
+  CHECK(duties.forward + duties.reverse <= tight.budget_duty);
+  CHECK(duties.forward == 1638 && duties.reverse == 819);
+  for (uint32_t forward = 0; forward <= 4096; forward += 97) {
+    for (uint32_t reverse = 0; reverse <= 4096; reverse += 89) {
+      const BridgeDuties d = limit_bridge_duties(tight, forward, reverse);
+      CHECK(d.forward <= tight.half_max_duty &&
+            d.reverse <= tight.half_max_duty);
+      CHECK(d.forward + d.reverse <= tight.budget_duty);
+    }
+  }
+  return check::failures();
+}
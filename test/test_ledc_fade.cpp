@@ -0,0 +1,44 @@
+#include "check.h"
+#include "utils/ledc_fade.h"
+
+using namespace ledc;
+
+// run the segments the way the fade engine would
+static uint32_t end_duty(uint32_t duty, const FadeSegment *segments,
+                         size_t count, uint64_t *cycles) {
+  *cycles = 0;
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t change = uint32_t(segments[i].scale) * segments[i].step_num;
+    duty = segments[i].increase ? duty + change : duty - change;
+    *cycles += uint64_t(segments[i].cycle_num) * segments[i].step_num;
+  }
+  return duty;
+}
+
+int main() {
+  FadeSegment segments[16];
+  uint64_t cycles = 0;
+
+  // a straight fade up lands on its end and takes its time
+  const FadePoint up[] = {{.time_ms = 1000, .duty = 4000}};
+  size_t n = plan_fade_segments(0, up, 1, 10000, segments);
+  CHECK(n == 1);
+  CHECK(end_duty(0, segments, n, &cycles) <= 4000);
+  CHECK(end_duty(0, segments, n, &cycles) >= 4000 - FADE_PARAM_MAX);
+  CHECK(cycles >= 9000 && cycles <= 11000);
+
+  // a path that turns round never leaves the hardware's range, and the
+  // error from one segment doesn't carry into the next
+  const FadePoint turn[] = {{.time_ms = 100, .duty = 3000},
+                            {.time_ms = 200, .duty = 3000},
+                            {.time_ms = 500, .duty = 17}};
+  n = plan_fade_segments(1000, turn, 3, 10000, segments);
+  for (size_t i = 0; i < n; i++) {
+    CHECK(segments[i].scale <= FADE_PARAM_MAX);
+    CHECK(segments[i].step_num <= FADE_PARAM_MAX);
+    CHECK(segments[i].cycle_num >= 1 && segments[i].cycle_num <= FADE_PARAM_MAX);
+  }
+  const uint32_t landed = end_duty(1000, segments, n, &cycles);
+  CHECK_MSG(landed >= 17 && landed < 17 + 32, "landed on %u", landed);
+  return check::failures();
+}
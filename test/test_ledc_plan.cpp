@@ -0,0 +1,43 @@
+#include "check.h"
+#include "utils/float_output.h"
+#include "utils/ledc_plan.h"
+
+using namespace ledc;
+
+static constexpr uint8_t FRACTION = 4;
+
+class TestOutput : public output::FloatOutput {
+protected:
+  void write_state(float) override {}
+};
+
+static uint32_t full(uint8_t bits) { return ((1U << bits) - 1) << FRACTION; }
+
+int main() {
+  // the ends stay put across every retune between 8 and 14 bits
+  for (uint8_t from = 8; from <= 14; from++) {
+    for (uint8_t to = 8; to <= 14; to++) {
+      CHECK(rescale_duty(0, from, to, FRACTION) == 0);
+      CHECK(rescale_duty(full(from), from, to, FRACTION) == full(to));
+    }
+  }
+
+  // in between it's the same share of full scale, to the nearest fine count
+  for (uint32_t duty = 0; duty <= full(12); duty += 13) {
+    const uint32_t down = rescale_duty(duty, 12, 10, FRACTION);
+    const double want = double(duty) * full(10) / full(12);
+    CHECK_MSG(down >= want - 0.5 && down <= want + 0.5,
+              "%u at 12 bits became %u at 10, want %.2f", duty, down, want);
+    // and going up and back comes home
+    const uint32_t up = rescale_duty(duty, 12, 14, FRACTION);
+    CHECK(rescale_duty(up, 14, 12, FRACTION) == duty);
+  }
+
+  // an inverted output's off is full scale, which moves with the resolution,
+  // so the cached channel config has to be worked out again on a retune
+  TestOutput inverted;
+  inverted.set_inverted(true);
+  CHECK(inverted.transform_duty(0, 1U << 12) == 1U << 12);
+  CHECK(inverted.transform_duty(0, 1U << 10) == 1U << 10);
+  return check::failures();
+}
@@ -0,0 +1,60 @@
+#include "check.h"
+#include "light/level_control.h"
+
+using namespace light;
+
+int main() {
+  LevelControl control;
+  control.set_level(100, 0);
+  CHECK(control.current_level(0) == 100);
+
+  // a Move asks the LED task for its end, but reports where it has got to
+  const uint8_t up[] = {0x00, 50};
+  CHECK(control.handle_command(LEVEL_CMD_MOVE, up, sizeof(up), 10000));
+  CHECK(control.request().level == MAX_LEVEL);
+  CHECK(control.is_moving(10000));
+  CHECK(control.current_level(10000) == 100);
+  CHECK(control.current_level(11000) == 150);
+
+  // and lands on it at the end
+  CHECK(!control.is_moving(20000));
+  CHECK(control.current_level(20000) == MAX_LEVEL);
+
+  // a Stop freezes it where it got to
+  const uint8_t down[] = {0x01, 100};
+  CHECK(control.handle_command(LEVEL_CMD_MOVE, down, sizeof(down), 30000));
+  CHECK(control.handle_command(LEVEL_CMD_STOP, nullptr, 0, 30500));
+  CHECK(!control.is_moving(30500));
+  CHECK(control.current_level(30500) == MAX_LEVEL - 50);
+  CHECK(control.request().level == MAX_LEVEL - 50);
+
+  // Move to Level reports its target straight away
+  const uint8_t to[] = {20, 10, 0};
+  CHECK(control.handle_command(LEVEL_CMD_MOVE_TO_LEVEL, to, sizeof(to), 40000));
+  CHECK(!control.is_moving(40000));
+  CHECK(control.current_level(40000) == 20);
+
+  // a Move down with on/off reports reaching 0, and keeps the level it
+  // started from to come back to
+  control.set_level(100, 50000);
+  const uint8_t off[] = {0x01, 100};
+  CHECK(control.handle_command(LEVEL_CMD_MOVE_WITH_ON_OFF, off, sizeof(off),
+                               60000));
+  CHECK(control.current_level(60500) == 50);
+  CHECK(!control.is_moving(61000));
+  CHECK(control.current_level(61000) == 0);
+  CHECK(!control.request().on && control.request().level == 100);
+
+  // as does Move to Level with on/off to 0
+  control.set_level(80, 70000);
+  const uint8_t to_off[] = {0, 10, 0};
+  CHECK(control.handle_command(LEVEL_CMD_MOVE_TO_LEVEL_WITH_ON_OFF, to_off,
+                               sizeof(to_off), 80000));
+  CHECK(control.current_level(80000) == 0);
+  CHECK(!control.request().on && control.request().level == 80);
+
+  // and On brings it back
+  control.set_on(true, 90000);
+  CHECK(control.current_level(90000) == 80);
+  return check::failures();
+}
@@ -0,0 +1,85 @@
+#include <atomic>
+#include <thread>
+
+#include "check.h"
+#include "light/mailbox.h"
+
+using namespace light;
+
+// lets a test stand in for a post that's part way through
+class TestMailbox : public Mailbox<uint32_t> {
+public:
+  void hold_post(bool held) { this->posting_.store(held ? 1 : 0); }
+};
+
+int main() {
+  TestMailbox mailbox;
+  uint32_t value = 0xDEAD;
+
+  // nothing posted leaves the output alone
+  CHECK(!mailbox.take(value));
+  CHECK(value == 0xDEAD);
+
+  // one post, one take
+  CHECK(mailbox.post(1));
+  CHECK(mailbox.take(value) && value == 1);
+  CHECK(!mailbox.take(value) && value == 1);
+  CHECK(mailbox.overwritten() == 0);
+
+  // a burst collapses to the last value, counting what it replaced
+  for (uint32_t i = 10; i < 15; i++)
+    CHECK(mailbox.post(i));
+  CHECK(mailbox.take(value) && value == 14);
+  CHECK(!mailbox.take(value));
+  CHECK(mailbox.overwritten() == 4);
+
+  // a post arriving during another is dropped, and the one in flight wins
+  CHECK(mailbox.post(20));
+  mailbox.hold_post(true);
+  CHECK(!mailbox.post(21));
+  CHECK(mailbox.dropped() == 1);
+  mailbox.hold_post(false);
+  CHECK(mailbox.take(value) && value == 20);
+  CHECK(mailbox.overwritten() == 4);
+
+  // the slots keep rotating cleanly over many rounds
+  for (uint32_t i = 100; i < 200; i++) {
+    CHECK(mailbox.post(i));
+    if (i % 3 == 0)
+      CHECK(mailbox.take(value) && value == i);
+  }
+
+  // a producer and consumer on their own threads: the consumer only ever
+  // sees values in order, never a torn one, and ends on the last
+  {
+    Mailbox<uint64_t> shared;
+    static constexpr uint32_t COUNT = 200000;
+    std::atomic<bool> done{false};
+    std::thread producer([&] {
+      for (uint32_t i = 1; i <= COUNT; i++)
+        shared.post((uint64_t(i) << 32) | i);
+      done = true;
+    });
+    uint64_t last = 0;
+    uint32_t taken = 0;
+    bool ordered = true;
+    for (;;) {
+      const bool finished = done.load();
+      uint64_t got;
+      while (shared.take(got)) {
+        ordered &= (got >> 32) == (got & 0xFFFFFFFF) && got > last;
+        last = got;
+        taken++;
+      }
+      if (finished)
+        break;
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK((last & 0xFFFFFFFF) == COUNT);
+    CHECK(taken + shared.overwritten() == COUNT);
+    CHECK(shared.dropped() == 0);
+  }
+
+  return check::failures();
+}
@@ -0,0 +1,58 @@
+#include <cmath>
+#include <cstdlib>
+
+#include "check.h"
+#include "light/pixel_frame.h"
+
+using namespace light;
+
+// what a channel should come out as: the curve of the channel times the
+// curve of the brightness, rounded once at the end
+static int reference(uint8_t value, uint32_t brightness) {
+  const double channel = output::GammaCurve::apply(value / 255.0);
+  const double gain = output::GammaCurve::apply(brightness / 256.0);
+  return int(std::lround(channel * gain * 255.0));
+}
+
+int main() {
+  // every channel at every brightness, within a count of the reference;
+  // interpolating the brightness curve costs at most that, where curving
+  // after scaling was out by up to 3
+  for (uint32_t brightness = 0; brightness <= 256; brightness++) {
+    const uint32_t gain = pixel_gain<output::GammaCurve>(brightness);
+    for (uint32_t value = 0; value < 256; value++) {
+      const int got = pixel_channel<output::GammaCurve>(value, gain);
+      const int want = reference(value, brightness);
+      CHECK_MSG(std::abs(got - want) <= 1,
+                "channel %u at brightness %u is %d, expected %d", value,
+                brightness, got, want);
+    }
+  }
+
+  // a dim white string stays lit; curving after scaling rounded it to 0
+  // at brightness 28 and below
+  {
+    Pixel from[1], to[1];
+    uint8_t out[3];
+    PixelFrame<> frame(from, to, 1);
+    PixelFrame<>::fill(frame.retarget(0), 1, pixel_rgb(255, 255, 255));
+    frame.fade_to(0, 0);
+    frame.render(0, 28, out);
+    CHECK(out[0] == 1 && out[1] == 1 && out[2] == 1);
+  }
+
+  // full brightness passes the curve straight through
+  {
+    Pixel from[1], to[1];
+    uint8_t out[3];
+    PixelFrame<> frame(from, to, 1);
+    PixelFrame<>::fill(frame.retarget(0), 1, pixel_rgb(255, 128, 0));
+    frame.fade_to(0, 0);
+    frame.render(0, 256, out);
+    CHECK(out[0] == output::curve_duty(128, 8));
+    CHECK(out[1] == 255);
+    CHECK(out[2] == 0);
+  }
+
+  return check::failures();
+}
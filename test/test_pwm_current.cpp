@@ -0,0 +1,34 @@
+#include "check.h"
+#include "utils/pwm_current.h"
+
+using namespace ledc;
+
+int main() {
+  // the hpoint an output gets from its phase angle is the exact even split
+  // the current model assumes, at every bit depth and string count
+  for (uint8_t bits = 1; bits <= 20; bits++) {
+    for (size_t count = 1; count <= 6; count++) {
+      for (size_t i = 0; i < count; i++) {
+        const uint32_t exact = uint32_t((uint64_t(i) << bits) / count);
+        CHECK_MSG(phase_hpoint(stagger_angle(i, count), bits) == exact,
+                  "string %zu of %zu at %u bits", i, count, bits);
+      }
+    }
+    CHECK(phase_hpoint(180.0f, bits) == (1U << bits) / 2);
+    CHECK(phase_hpoint(360.0f, bits) == 0);
+  }
+
+  // three 100 mA strings at a quarter duty stack to 300 mA in phase, and
+  // don't overlap at all staggered
+  StringLoad loads[3];
+  for (size_t i = 0; i < 3; i++)
+    loads[i] = {.hpoint = 0, .duty = 1024, .current_ma = 100};
+  const CurrentStats stacked = model_string_current(loads, 3, 12);
+  for (size_t i = 0; i < 3; i++)
+    loads[i].hpoint = stagger_hpoint(i, 3, 12);
+  const CurrentStats staggered = model_string_current(loads, 3, 12);
+  CHECK(stacked.peak_ma == 300);
+  CHECK(staggered.peak_ma == 100);
+  CHECK(stacked.mean_ma == staggered.mean_ma);
+  return check::failures();
+}
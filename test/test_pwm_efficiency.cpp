@@ -0,0 +1,75 @@
+#include <cmath>
+#include <iterator>
+
+#include "check.h"
+#include "utils/pwm_efficiency.h"
+
+using namespace ledc;
+
+// The runtime model over a typical day against the fixed 10 kHz, and the
+// policy's band selection and hysteresis. The map is the placeholder one, so
+// the estimate shows the model works, not what a board will gain.
+int main() {
+  const EfficiencyMap &map = DEFAULT_EFFICIENCY_MAP;
+  const size_t fixed = *map.frequency_index(10000);
+  const size_t count = std::size(TYPICAL_DAY);
+
+  // efficiencies in permille
+  std::printf("%8s %8s %8s %8s %8s\n", "duty", "minutes", "10 kHz", "best Hz",
+              "best");
+  double fixed_draw = 0;
+  double best_draw = 0;
+  for (const DailyLevel &level : TYPICAL_DAY) {
+    const size_t band = map.band_for(level.duty_permille);
+    const size_t best = map.best_frequency(band);
+    std::printf("%8u %8u %8u %8u %8u\n", level.duty_permille,
+                level.minutes, map.efficiency(band, fixed),
+                map.frequency_hz[best], map.efficiency(band, best));
+    const double output = double(level.duty_permille) * level.minutes;
+    fixed_draw += output / map.efficiency(band, fixed);
+    best_draw += output / map.efficiency(band, best);
+  }
+  const uint32_t gain = model_runtime_gain_permille(map, TYPICAL_DAY, count,
+                                                    fixed);
+  std::printf("estimated to run %u permille longer than fixed 10 kHz\n", gain);
+
+  // the integer model agrees with working it out in floating point
+  const double want = (fixed_draw / best_draw - 1.0) * 1000.0;
+  CHECK_MSG(std::fabs(gain - want) <= 1.0, "gain %u, float model %.2f", gain,
+            want);
+  // picking by level never does worse than any one fixed frequency
+  for (size_t frequency = 0; frequency < map.frequency_count; frequency++)
+    CHECK(model_daily_draw(map, TYPICAL_DAY, count, {}) <=
+          model_daily_draw(map, TYPICAL_DAY, count, frequency));
+  CHECK(model_runtime_gain_permille(map, TYPICAL_DAY, count,
+                                    map.best_frequency(0)) > 0);
+
+  // bands split at their tops, and anything past the last is in it
+  CHECK(map.band_for(0) == 0 && map.band_for(50) == 0);
+  CHECK(map.band_for(51) == 1 && map.band_for(150) == 1);
+  CHECK(map.band_for(400) == 2 && map.band_for(401) == 3);
+  CHECK(map.band_for(2000) == 3);
+
+  // starts on the best for full duty, goes slow for a night light and back
+  ProfilePolicy policy(map);
+  CHECK(policy.frequency_hz() == 10000);
+  CHECK(policy.select(30) == 3000);
+  CHECK(policy.select(1000) == 10000);
+
+  // at 40% 5 kHz is best, 15‰ up on 10 kHz, past the default hysteresis
+  CHECK(policy.select(400) == 5000);
+  // but only 5‰ up on 3 kHz, so from there it stays put
+  policy.select(30);
+  CHECK(policy.select(400) == 3000);
+
+  // a level wandering across a band edge doesn't flip the frequency back and
+  // forth once the hysteresis is wider than the difference
+  ProfilePolicy steady(map);
+  steady.set_hysteresis_permille(25);
+  CHECK(steady.select(401) == 10000);
+  CHECK(steady.select(400) == 10000);
+  CHECK(steady.select(401) == 10000);
+  // and still moves for a big enough gain
+  CHECK(steady.select(30) == 3000);
+  return check::failures();
+}
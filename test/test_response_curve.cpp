@@ -0,0 +1,45 @@
+#include <cmath>
+#include <cstdlib>
+
+#include "check.h"
+#include "utils/response_curve.h"
+
+using namespace output;
+
+// every entry should be what std::pow gives, rounded the same way
+template <unsigned N, unsigned D = 10> static void check_power_table() {
+  const auto &table = CURVE_TABLE<PowerCurve<N, D>>;
+  const double exponent = double(N) / double(D);
+  for (size_t i = 0; i < CURVE_TABLE_SIZE; i++) {
+    const double x = double(i) / double(CURVE_TABLE_SIZE - 1);
+    const auto expected =
+        uint16_t(std::pow(x, exponent) * CURVE_TABLE_MAX + 0.5);
+    CHECK_MSG(table[i] == expected, "x^%g entry %zu is %u, pow gives %u",
+              exponent, i, table[i], expected);
+  }
+}
+
+int main() {
+  check_power_table<28>();
+  check_power_table<22>();
+  check_power_table<2, 1>();
+  check_power_table<1, 2>();
+
+  // the interpolated curve lands on the table at every 8-bit level, and
+  // never goes backwards in between
+  uint32_t last = 0;
+  for (uint32_t level = 0; level <= 0xFFFF; level++) {
+    const uint32_t fine = curve_fine_q8<GammaCurve>(uint16_t(level));
+    CHECK_MSG(fine >= last, "curve drops at level %u", level);
+    last = fine;
+    if (level % 257 == 0)
+      CHECK(fine == uint32_t(CURVE_TABLE<GammaCurve>[level / 257]) << 8);
+  }
+
+  // full scale maps to the top duty code at every bit depth
+  for (uint8_t bits = 1; bits <= 16; bits++) {
+    CHECK(curve_duty(255, bits) == (1U << bits) - 1);
+    CHECK(curve_duty(0, bits) == 0);
+  }
+  return check::failures();
+}
@@ -0,0 +1,37 @@
+#include "check.h"
+#include "utils/ledc_plan.h"
+#include "utils/sdm.h"
+
+using namespace ledc;
+
+// The SDM's density register is the same width at any sample rate.
+static constexpr uint8_t SDM_BITS = sdm::SDMOutput::BIT_DEPTH;
+// and the LEDC dithers 4 more bits below a duty count.
+static constexpr uint8_t LEDC_FRACTION_BITS = 4;
+
+static uint8_t ledc_bits(uint32_t clock_hz, uint32_t frequency_hz) {
+  const auto plan = plan_frequency(clock_hz, frequency_hz);
+  return plan.has_value() ? plan->bit_depth : 0;
+}
+
+// Resolution of the LEDC from each clock against the SDM, by PWM frequency.
+int main() {
+  static constexpr uint32_t FREQUENCIES[] = {1000,   3000,   10000, 20000,
+                                             100000, 312500, 1000000};
+
+  std::printf("%10s %8s %8s %8s\n", "PWM Hz", "APB", "RC_FAST", "SDM");
+  for (uint32_t hz : FREQUENCIES) {
+    std::printf("%10u %8u %8u %8u\n", hz, ledc_bits(APB_CLOCK_HZ, hz),
+                ledc_bits(RC_FAST_CLOCK_HZ, hz), SDM_BITS);
+  }
+
+  // at the 10 kHz main runs at, the LEDC has 12 bits plus dithering
+  CHECK(ledc_bits(APB_CLOCK_HZ, 10000) == 12);
+  CHECK(ledc_bits(APB_CLOCK_HZ, 10000) + LEDC_FRACTION_BITS > SDM_BITS);
+  // it's down to the SDM's 8 bits from 312.5 kHz
+  CHECK(ledc_bits(APB_CLOCK_HZ, 312500) == SDM_BITS);
+  CHECK(ledc_bits(APB_CLOCK_HZ, 312501) < SDM_BITS);
+  // and from RC_FAST, which runs in light sleep, much sooner
+  CHECK(ledc_bits(RC_FAST_CLOCK_HZ, 100000) < SDM_BITS);
+  return check::failures();
+}